@@ -0,0 +1,132 @@
+/*
+ * This example shows how to draw rotated and scaled sprites on the Background layer with drawAffineBitmap() and
+ * drawAffineMonoBitmap(), and measures how many 32x32 sprites can be drawn in each frame on a 128x64 display
+ *
+ * Sprites are drawn with nearest sampling for a few seconds, then with bilinear sampling.  Every second, the time
+ * each sprite takes to draw is printed to Serial, along with how many would fit in the time one refresh frame takes.
+ *
+ * This example uses only the SmartMatrix Background layer
+ */
+
+#include <SmartLEDShieldV4.h>  // comment out this line for if you're not using SmartLED Shield V4 hardware (this line needs to be before #include <SmartMatrix3.h>)
+#include <SmartMatrix3.h>
+
+#define COLOR_DEPTH 24                  // known working: 24, 48 - If the sketch uses type `rgb24` directly, COLOR_DEPTH must be 24
+const uint8_t kMatrixWidth = 128;       // known working: 32, 64, 96, 128
+const uint8_t kMatrixHeight = 64;       // known working: 16, 32, 48, 64
+const uint8_t kRefreshDepth = 36;       // known working: 24, 36, 48
+const uint8_t kDmaBufferRows = 4;       // known working: 2-4, use 2 to save memory, more to keep from dropping frames and automatically lowering refresh rate
+const uint8_t kPanelType = SMARTMATRIX_HUB75_32ROW_MOD16SCAN; // use SMARTMATRIX_HUB75_16ROW_MOD8SCAN for common 16x32 panels, or use SMARTMATRIX_HUB75_64ROW_MOD32SCAN for common 64x64 panels
+const uint8_t kMatrixOptions = (SMARTMATRIX_OPTIONS_NONE);      // see http://docs.pixelmatix.com/SmartMatrix for options
+const uint8_t kBackgroundLayerOptions = (SM_BACKGROUND_OPTIONS_NONE);
+
+SMARTMATRIX_ALLOCATE_BUFFERS(matrix, kMatrixWidth, kMatrixHeight, kRefreshDepth, kDmaBufferRows, kPanelType, kMatrixOptions);
+SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(backgroundLayer, kMatrixWidth, kMatrixHeight, COLOR_DEPTH, kBackgroundLayerOptions);
+
+// 128 pixel wide rows take longer to shift out, so refresh at a lower rate than the default
+const uint8_t kRefreshRate = 60;
+
+const int kSpriteSize = 32;
+const int kSpritesWide = 4;
+const int kSpritesHigh = 2;
+
+// a ring with a pointer, so the rotation can be seen.  Black pixels are left transparent
+rgb24 sprite[kSpriteSize * kSpriteSize];
+
+// a gauge needle in the format used by drawMonoBitmap(): each row is (width / 8) + 1 bytes, MSB first
+const int kNeedleWidth = 28;
+const int kNeedleHeight = 3;
+uint8_t needle[kNeedleHeight * ((kNeedleWidth / 8) + 1)];
+
+void createSprites() {
+  for (int y = 0; y < kSpriteSize; y++) {
+    for (int x = 0; x < kSpriteSize; x++) {
+      int dx = 2 * x + 1 - kSpriteSize;
+      int dy = 2 * y + 1 - kSpriteSize;
+      int distanceSquared = dx * dx + dy * dy;
+      rgb24 color = {0, 0, 0};
+
+      if (distanceSquared < 31 * 31 && distanceSquared > 22 * 22)
+        color = rgb24(x * 8, y * 8, 255 - x * 8);
+      else if (abs(dx) < 3 && dy < 0)
+        color = rgb24(255, 255, 255);
+
+      sprite[y * kSpriteSize + x] = color;
+    }
+  }
+
+  for (int y = 0; y < kNeedleHeight; y++) {
+    for (int x = 0; x < kNeedleWidth; x++) {
+      // taper to a point
+      if (y == 1 || x < kNeedleWidth * 2 / 3)
+        needle[y * ((kNeedleWidth / 8) + 1) + (x / 8)] |= 0x80 >> (x % 8);
+    }
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  createSprites();
+
+  matrix.addLayer(&backgroundLayer);
+  matrix.setRefreshRate(kRefreshRate);
+  matrix.begin();
+
+  matrix.setBrightness(128);
+}
+
+void loop() {
+  static uint32_t frames = 0;
+  static uint32_t spritesDrawn = 0;
+  static uint32_t drawingMicros = 0;
+  static uint32_t lastReport = millis();
+  static bool bilinear = false;
+  static int reports = 0;
+
+  uint8_t flags = SM_AFFINE_TRANSPARENT_BLACK | (bilinear ? SM_AFFINE_BILINEAR : SM_AFFINE_NEAREST);
+  float angle = frames * 2.0f;
+
+  backgroundLayer.fillScreen({0, 0, 0});
+
+  // only the drawing is timed, not working out the transforms
+  for (int i = 0; i < kSpritesWide * kSpritesHigh; i++) {
+    float spriteAngle = (i % 2) ? -angle : angle;
+    float scale = 0.75f + 0.25f * sinf((angle + i * 45) * (float)M_PI / 180.0f);
+    smAffineTransform transform = smAffineRotateScale(spriteAngle, scale, kSpriteSize / 2, kSpriteSize / 2,
+      (i % kSpritesWide) * kSpriteSize + kSpriteSize / 2, (i / kSpritesWide) * kSpriteSize + kSpriteSize / 2);
+
+    uint32_t start = micros();
+    backgroundLayer.drawAffineBitmap(transform, kSpriteSize, kSpriteSize, sprite, flags);
+    drawingMicros += micros() - start;
+    spritesDrawn++;
+  }
+
+  // a needle pivoting at its left end in the center of the screen, sweeping like a gauge
+  smAffineTransform needleTransform = smAffineRotateScale(180 + 90 * sinf(angle * (float)M_PI / 180.0f), 1.0f,
+    1.5f, kNeedleHeight / 2.0f, kMatrixWidth / 2, kMatrixHeight / 2);
+  backgroundLayer.drawAffineMonoBitmap(needleTransform, kNeedleWidth, kNeedleHeight, {255, 0, 0}, needle,
+    bilinear ? SM_AFFINE_BILINEAR : SM_AFFINE_NEAREST);
+
+  backgroundLayer.swapBuffers(false);
+  frames++;
+
+  if (millis() - lastReport >= 1000) {
+    float microsPerSprite = (float)drawingMicros / spritesDrawn;
+
+    Serial.print(bilinear ? "bilinear: " : "nearest: ");
+    Serial.print(microsPerSprite);
+    Serial.print(" us per 32x32 sprite, ");
+    Serial.print((int)((1000000.0f / matrix.getRefreshRate()) / microsPerSprite));
+    Serial.print(" sprites per refresh frame at ");
+    Serial.print(matrix.getRefreshRate());
+    Serial.println(" Hz");
+
+    spritesDrawn = 0;
+    drawingMicros = 0;
+    lastReport = millis();
+
+    if (++reports % 5 == 0)
+      bilinear = !bilinear;
+  }
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds each test_*.cpp in this directory against the library for the Linux simulator and runs it.  Run from anywhere,
+# e.g. extras/tests/run_tests.sh.  Set CXX and CXXFLAGS to change the compiler or add flags, and LDLIBS=-lrt on older
+# glibc.  Exits non-zero if any test fails to build or fails.
+
+cd "$(dirname "$0")/../.." || exit 1
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2 -Wall}
+BUILD=$(mktemp -d) || exit 1
+trap 'rm -rf "$BUILD"' EXIT
+
+failed=0
+for test in extras/tests/test_*.cpp; do
+    name=$(basename "$test" .cpp)
+    echo "== $name"
+    if ! $CXX -std=gnu++11 $CXXFLAGS -pthread -I src "$test" src/*.cpp -x c++ src/Font_*.c $LDLIBS -o "$BUILD/$name"; then
+        echo "$name: build failed"
+        failed=1
+    elif ! "$BUILD/$name"; then
+        failed=1
+    fi
+done
+
+exit $failed
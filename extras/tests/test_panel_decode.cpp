@@ -0,0 +1,93 @@
+/*
+ * For every panel type in smPanelDescriptions, draws a pattern on a display two panels high, lets the simulator
+ * decode the packed rows the refresh code output, and compares the result with what was drawn pixel for pixel.  Each
+ * panel type runs in its own process, as the refresh code and simulator are set up once per program.  Built for the
+ * Linux simulator, see run_tests.sh
+ */
+
+#include <SmartMatrix3.h>
+#include <sys/wait.h>
+
+const uint8_t kMatrixWidth = 32;
+const uint8_t kRefreshDepth = 36;
+const uint8_t kDmaBufferRows = 4;
+
+rgb24 patternColor(int x, int y) {
+    return rgb24(x * 8, y * 4, (x * 5 + y * 3) & 0xFF);
+}
+
+template <unsigned char panelType>
+int checkPanelType(const char * name) {
+    const uint8_t kMatrixHeight = 2 * CONVERT_PANELTYPE_TO_MATRIXPANELHEIGHT(panelType);
+    SMARTMATRIX_ALLOCATE_BUFFERS(matrix, kMatrixWidth, kMatrixHeight, kRefreshDepth, kDmaBufferRows, panelType, SMARTMATRIX_OPTIONS_NONE);
+    SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(backgroundLayer, kMatrixWidth, kMatrixHeight, 24, SM_BACKGROUND_OPTIONS_NONE);
+    static SM_RGB framebuffer[kMatrixWidth * kMatrixHeight];
+    int errors = 0;
+
+    matrix.addLayer(&backgroundLayer);
+    backgroundLayer.enableColorCorrection(false);
+    matrix.setBrightness(255);
+    matrix.begin();
+
+    for(int y = 0; y < kMatrixHeight; y++) {
+        for(int x = 0; x < kMatrixWidth; x++)
+            backgroundLayer.drawPixel(x, y, patternColor(x, y));
+    }
+    backgroundLayer.swapBuffers(true);
+
+    // a whole frame refreshed after the swap
+    uint32_t start = SMDriverLinuxSim::getFramesRefreshed();
+    while(SMDriverLinuxSim::getFramesRefreshed() < start + 2)
+        delay(1);
+    SMDriverLinuxSim::getFramebuffer(framebuffer);
+    SMDriverLinuxSim::end();
+
+    for(int y = 0; y < kMatrixHeight; y++) {
+        for(int x = 0; x < kMatrixWidth; x++) {
+            rgb24 expected = patternColor(x, y);
+            rgb24 decoded = framebuffer[y * kMatrixWidth + x];
+
+            // the decoded channels are rounded from the bitplanes, so allow a little difference
+            if(abs(expected.red - decoded.red) + abs(expected.green - decoded.green) + abs(expected.blue - decoded.blue) > 3) {
+                if(errors < 4)
+                    printf("%s (%d, %d): drew %d %d %d, decoded %d %d %d\n", name, x, y, expected.red, expected.green,
+                        expected.blue, decoded.red, decoded.green, decoded.blue);
+                errors++;
+            }
+        }
+    }
+
+    printf("%s: %dx%d, %d pixels wrong\n", name, kMatrixWidth, kMatrixHeight, errors);
+    return errors;
+}
+
+// runs check in a child process, returns 1 if it failed
+int runInChild(int (*check)(const char *), const char * name) {
+    int status;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0) {
+        int errors = check(name);
+        fflush(stdout);
+        _exit(errors ? 1 : 0);
+    }
+    if(pid < 0 || waitpid(pid, &status, 0) != pid)
+        return 1;
+
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+int main() {
+    int errors = 0;
+
+    errors += runInChild(checkPanelType<SMARTMATRIX_HUB75_32ROW_MOD16SCAN>, "SMARTMATRIX_HUB75_32ROW_MOD16SCAN");
+    errors += runInChild(checkPanelType<SMARTMATRIX_HUB75_16ROW_MOD8SCAN>, "SMARTMATRIX_HUB75_16ROW_MOD8SCAN");
+    errors += runInChild(checkPanelType<SMARTMATRIX_HUB75_64ROW_MOD32SCAN>, "SMARTMATRIX_HUB75_64ROW_MOD32SCAN");
+    errors += runInChild(checkPanelType<SMARTMATRIX_HUB75_16ROW_MOD4SCAN>, "SMARTMATRIX_HUB75_16ROW_MOD4SCAN");
+    errors += runInChild(checkPanelType<SMARTMATRIX_HUB75_32ROW_MOD8SCAN>, "SMARTMATRIX_HUB75_32ROW_MOD8SCAN");
+    errors += runInChild(checkPanelType<SMARTMATRIX_HUB75_CUSTOM>, "SMARTMATRIX_HUB75_CUSTOM");
+
+    printf("%s: %d panel types failed\n", errors ? "FAIL" : "PASS", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Checks that the panel refreshes at exactly the configured rate: counts the frames the simulator refreshes over a
+ * fixed interval, and checks the rate it measures in simulated timer ticks.  Rates that don't divide the timer
+ * frequency evenly need the ticks lost to rounding added back.  Each rate runs in its own process, as the refresh code
+ * and simulator are set up once per program.  Built for the Linux simulator, see run_tests.sh
+ */
+
+#include <SmartMatrix3.h>
+#include <sys/wait.h>
+
+const uint8_t kMatrixWidth = 32;
+const uint8_t kMatrixHeight = 32;
+const uint8_t kRefreshDepth = 36;
+const uint8_t kDmaBufferRows = 4;
+
+SMARTMATRIX_ALLOCATE_BUFFERS(matrix, kMatrixWidth, kMatrixHeight, kRefreshDepth, kDmaBufferRows, SMARTMATRIX_HUB75_32ROW_MOD16SCAN, SMARTMATRIX_OPTIONS_NONE);
+SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(backgroundLayer, kMatrixWidth, kMatrixHeight, 24, SM_BACKGROUND_OPTIONS_NONE);
+
+const uint32_t kIntervalMillis = 2000;
+
+int checkRefreshRate(uint8_t refreshRate) {
+    int errors = 0;
+
+    matrix.addLayer(&backgroundLayer);
+    matrix.setRefreshRate(refreshRate);
+    matrix.begin();
+
+    // let the DMA buffer fill and the first frames go out
+    delay(100);
+
+    uint32_t startMillis = millis();
+    uint32_t startFrames = SMDriverLinuxSim::getFramesRefreshed();
+    while(millis() - startMillis < kIntervalMillis)
+        delay(1);
+    uint32_t frames = SMDriverLinuxSim::getFramesRefreshed() - startFrames;
+    uint32_t elapsedMillis = millis() - startMillis;
+    double measuredRate = SMDriverLinuxSim::getMeasuredRefreshRate();
+
+    SMDriverLinuxSim::end();
+
+    // counted against the host's clock, so allow a few frames either way for scheduling
+    uint32_t expectedFrames = ((uint32_t)refreshRate * elapsedMillis) / 1000;
+    if(frames + 3 < expectedFrames || frames > expectedFrames + 3) {
+        printf("%d Hz: refreshed %u frames in %u ms, expected %u\n", refreshRate, frames, elapsedMillis, expectedFrames);
+        errors++;
+    }
+
+    // in simulated ticks the rate is exact, apart from the first frame starting partway through a second
+    if(measuredRate < refreshRate - 0.01 || measuredRate > refreshRate + 0.01) {
+        printf("%d Hz: measured %.4f Hz in timer ticks\n", refreshRate, measuredRate);
+        errors++;
+    }
+
+    printf("%d Hz: %u frames in %u ms, measured %.4f Hz\n", refreshRate, frames, elapsedMillis, measuredRate);
+    return errors;
+}
+
+// runs the check in a child process, returns 1 if it failed
+int runInChild(uint8_t refreshRate) {
+    int status;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0) {
+        int errors = checkRefreshRate(refreshRate);
+        fflush(stdout);
+        _exit(errors ? 1 : 0);
+    }
+    if(pid < 0 || waitpid(pid, &status, 0) != pid)
+        return 1;
+
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+int main() {
+    int errors = 0;
+
+    // 120 Hz divides the timer frequency evenly, the others don't
+    errors += runInChild(120);
+    errors += runInChild(97);
+    errors += runInChild(61);
+
+    printf("%s: %d refresh rates failed\n", errors ? "FAIL" : "PASS", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+View the shared memory preview written by the SmartMatrix Linux simulator (see MatrixDriver_LinuxSim.h and
+MatrixPreview.h).
+
+Usage:
+  smpreview.py                          show the panel in the terminal (needs 24-bit color), Ctrl-C to stop
+  smpreview.py --name /other            read a preview opened with beginPreview("/other")
+  smpreview.py --stats                  print the refresh rate measured from the frame timestamps, every second
+  smpreview.py --ppm frame.ppm          save the latest frame as a PPM image and exit
+
+The preview is only mapped for reading, so any number of viewers can run alongside the sketch.
+"""
+
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+# must match smPreviewHeader and smPreviewSlot in MatrixPreview.h
+HEADER_FORMAT = '<I6HII8x'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+SLOT_FORMAT = '<IIQII'
+SLOT_SIZE = struct.calcsize(SLOT_FORMAT)
+MAGIC = 0x56504D53
+SUPPORTED_VERSION = 1
+LATEST_FRAME_OFFSET = 20
+
+class Preview:
+    def __init__(self, name):
+        path = '/dev/shm/' + name.lstrip('/')
+        with open(path, 'rb') as f:
+            self.memory = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        if len(self.memory) < HEADER_SIZE:
+            raise ValueError('%s is too small' % path)
+        (magic, version, self.header_size, self.width, self.height, self.slot_count, _,
+         self.slot_size, _) = struct.unpack_from(HEADER_FORMAT, self.memory)
+        if magic != MAGIC:
+            raise ValueError('%s is not a SmartMatrix preview' % path)
+        if version != SUPPORTED_VERSION:
+            raise ValueError('unsupported preview version %d' % version)
+
+    def latest_frame(self):
+        return struct.unpack_from('<I', self.memory, LATEST_FRAME_OFFSET)[0]
+
+    def read(self):
+        """Returns (frame, timestamp_ns, rows_refreshed, pixels) for the newest frame, or None before the first."""
+        pixel_bytes = self.width * self.height * 3
+        while True:
+            latest = self.latest_frame()
+            if not latest:
+                return None
+            offset = self.header_size + ((latest - 1) % self.slot_count) * self.slot_size
+            sequence = struct.unpack_from('<I', self.memory, offset)[0]
+            if sequence & 1:
+                continue
+            sequence, frame, timestamp, rows, _ = struct.unpack_from(SLOT_FORMAT, self.memory, offset)
+            pixels = self.memory[offset + SLOT_SIZE:offset + SLOT_SIZE + pixel_bytes]
+            # the slot was rewritten while copying, try again with the newer frame
+            if struct.unpack_from('<I', self.memory, offset)[0] != sequence:
+                continue
+            return frame, timestamp, rows, pixels
+
+def draw_terminal(preview, pixels, status, out):
+    # two pixels per character: foreground is the top pixel, background the bottom
+    lines = ['\x1b[H']
+    width = preview.width
+    for y in range(0, preview.height, 2):
+        line = []
+        for x in range(width):
+            top = (y * width + x) * 3
+            bottom = ((y + 1) * width + x) * 3 if y + 1 < preview.height else None
+            line.append('\x1b[38;2;%d;%d;%dm' % tuple(pixels[top:top + 3]))
+            if bottom is not None:
+                line.append('\x1b[48;2;%d;%d;%dm' % tuple(pixels[bottom:bottom + 3]))
+            line.append('▀')
+        lines.append(''.join(line) + '\x1b[0m\n')
+    lines.append(status + '\x1b[K\n')
+    out.write(''.join(lines))
+    out.flush()
+
+def write_ppm(preview, pixels, path):
+    with open(path, 'wb') as f:
+        f.write(b'P6\n%d %d\n255\n' % (preview.width, preview.height))
+        f.write(pixels)
+
+def frame_rate(previous, current):
+    if not previous or current[1] == previous[1]:
+        return 0.0
+    return (current[0] - previous[0]) * 1e9 / (current[1] - previous[1])
+
+def main():
+    parser = argparse.ArgumentParser(description='View the SmartMatrix Linux simulator preview')
+    parser.add_argument('--name', default='/smartmatrix', help='shared memory name passed to beginPreview()')
+    parser.add_argument('--stats', action='store_true', help='print the measured refresh rate instead of the panel')
+    parser.add_argument('--ppm', help='save the latest frame to this file and exit')
+    parser.add_argument('--fps', type=float, default=30, help='terminal update rate')
+    options = parser.parse_args()
+
+    try:
+        preview = Preview(options.name)
+    except (OSError, ValueError) as e:
+        sys.exit('smpreview: %s' % e)
+
+    latest = preview.read()
+    while latest is None:
+        time.sleep(0.01)
+        latest = preview.read()
+
+    if options.ppm:
+        write_ppm(preview, latest[3], options.ppm)
+        return
+
+    previous = (latest[0], latest[1])
+    if not options.stats:
+        sys.stdout.write('\x1b[2J')
+    try:
+        while True:
+            time.sleep(1.0 if options.stats else 1.0 / options.fps)
+            latest = preview.read()
+            rate = frame_rate(previous, (latest[0], latest[1]))
+            if options.stats:
+                print('frame %d  %.1f frames/s  %d rows refreshed' % (latest[0], rate, latest[2]))
+                previous = (latest[0], latest[1])
+            else:
+                if latest[1] - previous[1] >= 1e9:
+                    previous = (latest[0], latest[1])
+                draw_terminal(preview, latest[3], 'frame %d  %dx%d  %.1f frames/s' %
+                              (latest[0], preview.width, preview.height, rate), sys.stdout)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if not options.stats:
+            sys.stdout.write('\x1b[0m\n')
+
+if __name__ == '__main__':
+    main()
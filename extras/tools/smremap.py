@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""
+Generate the map for SMLayerRemap (see Layer_Remap.h) from a description of an installation.
+
+Usage:
+  smremap.py layout.json > layout_map.h     write the map as a C header
+  smremap.py layout.json --show             print which canvas pixel each hardware pixel shows, as a grid of regions
+
+The description is JSON:
+  {
+    "name": "stairsMap",
+    "width": 64, "height": 32,                the screen given to SMARTMATRIX_ALLOCATE_BUFFERS
+    "canvasWidth": 48, "canvasHeight": 48,    the logical canvas the sketch draws into
+    "regions": [
+      {"screen": [0, 0, 32, 16], "canvas": [0, 32]},
+      {"screen": [32, 0, 32, 16], "canvas": [16, 16], "rotation": 90, "mirror": false},
+      ...
+    ]
+  }
+
+Each region takes a rectangle of the screen, [x, y, width, height] in hardware coordinates (the order the panels are
+chained, before rotation), and shows it at [x, y] in the canvas.  "rotation" is how far the rectangle is turned
+clockwise in the installation (0, 90, 180 or 270), "mirror" flips it left to right before turning.  A region can be
+any part of a panel, so cut-outs are described by leaving the missing pixels out.  Screen pixels not in any region
+are blank (SM_REMAP_BLANK), and canvas pixels not shown by any region are simply never displayed.
+"""
+
+import argparse
+import json
+import sys
+
+BLANK = 0xFFFF
+
+def region_pixels(region):
+    """Yields ((screen x, screen y), (canvas x, canvas y)) for every pixel in the region."""
+    sx, sy, width, height = region['screen']
+    cx, cy = region['canvas']
+    rotation = region.get('rotation', 0)
+    mirror = region.get('mirror', False)
+    if rotation not in (0, 90, 180, 270):
+        raise ValueError('rotation must be 0, 90, 180 or 270, not %r' % rotation)
+
+    for v in range(height):
+        for u in range(width):
+            x = width - 1 - u if mirror else u
+            if rotation == 0:
+                dx, dy = x, v
+            elif rotation == 90:
+                dx, dy = height - 1 - v, x
+            elif rotation == 180:
+                dx, dy = width - 1 - x, height - 1 - v
+            else:
+                dx, dy = v, width - 1 - x
+            yield (sx + u, sy + v), (cx + dx, cy + dy)
+
+def build_map(layout):
+    width, height = layout['width'], layout['height']
+    canvas_width, canvas_height = layout['canvasWidth'], layout['canvasHeight']
+    if canvas_width * canvas_height > BLANK:
+        raise ValueError('canvas is too big, the map has 16-bit entries')
+
+    table = [BLANK] * (width * height)
+    for index, region in enumerate(layout['regions']):
+        for (x, y), (cx, cy) in region_pixels(region):
+            if not (0 <= x < width and 0 <= y < height):
+                raise ValueError('region %d: screen pixel (%d, %d) is off the %dx%d screen' % (index, x, y, width, height))
+            if not (0 <= cx < canvas_width and 0 <= cy < canvas_height):
+                raise ValueError('region %d: canvas pixel (%d, %d) is off the %dx%d canvas' %
+                                 (index, cx, cy, canvas_width, canvas_height))
+            if table[y * width + x] != BLANK:
+                raise ValueError('region %d: screen pixel (%d, %d) is already in another region' % (index, x, y))
+            table[y * width + x] = cy * canvas_width + cx
+    return table
+
+def write_header(layout, table, source, out):
+    name = layout.get('name', 'remapMap')
+    width = layout['width']
+    out.write('// generated by smremap.py from %s, don\'t edit\n' % source)
+    out.write('// %dx%d screen showing a %dx%d canvas, %d of %d pixels used\n\n' %
+              (width, layout['height'], layout['canvasWidth'], layout['canvasHeight'],
+               sum(1 for entry in table if entry != BLANK), len(table)))
+    out.write('const uint16_t %s[%d * %d] = {\n' % (name, width, layout['height']))
+    for row in range(layout['height']):
+        entries = table[row * width:(row + 1) * width]
+        out.write('    ' + ', '.join('0x%04X' % entry for entry in entries) + ',\n')
+    out.write('};\n')
+
+def show(layout, table, out):
+    # one character per screen pixel: the region it belongs to, or '.' if it's blank
+    width, height = layout['width'], layout['height']
+    owner = ['.'] * (width * height)
+    symbols = '0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ'
+    for index, region in enumerate(layout['regions']):
+        for (x, y), _ in region_pixels(region):
+            owner[y * width + x] = symbols[index % len(symbols)]
+    for row in range(height):
+        out.write(''.join(owner[row * width:(row + 1) * width]) + '\n')
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate an SMLayerRemap map from a layout description')
+    parser.add_argument('layout', help='JSON layout description')
+    parser.add_argument('--show', action='store_true', help='print the regions on the screen instead of the header')
+    options = parser.parse_args()
+
+    try:
+        with open(options.layout) as f:
+            layout = json.load(f)
+        table = build_map(layout)
+    except (OSError, ValueError, KeyError) as e:
+        sys.exit('smremap: %s' % e)
+
+    if options.show:
+        show(layout, table, sys.stdout)
+    else:
+        write_header(layout, table, options.layout, sys.stdout)
+
+if __name__ == '__main__':
+    main()
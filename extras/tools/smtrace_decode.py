@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+Decode a SmartMatrix refresh trace written by SMTrace::dump() and print it as a timeline.
+
+Usage:
+  smtrace_decode.py trace.bin                       decode a dump saved to a file
+  smtrace_decode.py --serial /dev/ttyACM0           wait for a dump on a serial port (needs pyserial)
+  smtrace_decode.py trace.bin --chrome trace.json   also write Chrome trace format, open in
+                                                    chrome://tracing or https://ui.perfetto.dev
+
+Timestamps in the dump are 32-bit and wrap (every ~44 seconds at 96MHz), the decoder assumes
+consecutive events are less than one wrap apart.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+HEADER_FORMAT = '<4sBBHII'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+EVENT_FORMAT = '<IBBH'
+EVENT_SIZE = struct.calcsize(EVENT_FORMAT)
+SUPPORTED_VERSION = 1
+
+# must match smTraceEventType in MatrixTrace.h
+EVENT_NAMES = {
+    1: 'FrameStart',
+    2: 'RowCalculationStart',
+    3: 'RowCalculationEnd',
+    4: 'RowShiftComplete',
+    5: 'Underrun',
+    6: 'UnderrunRecovered',
+    7: 'RefreshRateLowered',
+    8: 'BrightnessChange',
+    9: 'RotationChange',
+    10: 'SwapRequested',
+    11: 'SwapComplete',
+    12: 'DmaBufferRowsChange',
+    13: 'CallbackOverrun',
+    14: 'BrightnessFadeStep',
+}
+USER_EVENT_FIRST = 24
+
+LAYER_NAMES = {0: 'background', 1: 'indexed', 2: 'scaled', 3: 'remap'}
+
+# must match smDmaBufferRowsChange in SmartMatrix3.h
+DMA_ROWS_REASONS = {0: 'allocated', 1: 'user', 2: 'underrun', 3: 'unused'}
+
+def event_name(event_type):
+    if event_type >= USER_EVENT_FIRST:
+        return 'User%d' % (event_type - USER_EVENT_FIRST)
+    return EVENT_NAMES.get(event_type, 'Unknown%d' % event_type)
+
+def describe_args(event_type, arg0, arg1):
+    name = event_name(event_type)
+    if name in ('FrameStart', 'UnderrunRecovered', 'RefreshRateLowered'):
+        return 'refreshRate=%d' % arg1
+    if name == 'RowCalculationStart':
+        return 'rowsQueued=%d' % arg0
+    if name == 'RowCalculationEnd':
+        return 'rowsCalculated=%d' % arg0
+    if name == 'RowShiftComplete':
+        return 'rowsLeft=%d' % arg0
+    if name == 'BrightnessChange':
+        return 'dimmingFactor=%d' % arg1
+    if name == 'RotationChange':
+        return 'rotation=%d' % arg0
+    if name == 'SwapRequested':
+        return 'layer=%s copy=%d' % (LAYER_NAMES.get(arg0, arg0), arg1)
+    if name == 'SwapComplete':
+        return 'layer=%s' % LAYER_NAMES.get(arg0, arg0)
+    if name == 'DmaBufferRowsChange':
+        return 'rows=%d reason=%s' % (arg0, DMA_ROWS_REASONS.get(arg1, arg1))
+    if name == 'CallbackOverrun':
+        return 'callback=%s ticks=%d' % ('frame' if arg0 == 0xFF else 'row%d' % arg0, arg1)
+    if name == 'BrightnessFadeStep':
+        return 'step=%d luminance=%d' % (arg0, arg1)
+    if name.startswith('User') or name.startswith('Unknown'):
+        return 'arg0=%d arg1=%d' % (arg0, arg1)
+    return ''
+
+def parse_dump(data):
+    start = data.find(b'SMTR')
+    if start < 0:
+        raise ValueError('no SMTR header found')
+    magic, version, event_size, count, ticks_per_second, total_logged = struct.unpack_from(HEADER_FORMAT, data, start)
+    if version != SUPPORTED_VERSION:
+        raise ValueError('unsupported dump version %d' % version)
+    if event_size != EVENT_SIZE:
+        raise ValueError('unexpected event size %d' % event_size)
+    offset = start + HEADER_SIZE
+    if len(data) < offset + count * EVENT_SIZE:
+        raise ValueError('dump is truncated, expected %d events' % count)
+
+    events = []
+    previous = None
+    unwrapped = 0
+    for i in range(count):
+        timestamp, event_type, arg0, arg1 = struct.unpack_from(EVENT_FORMAT, data, offset + i * EVENT_SIZE)
+        if previous is not None:
+            unwrapped += (timestamp - previous) & 0xFFFFFFFF
+        previous = timestamp
+        events.append((unwrapped, event_type, arg0, arg1))
+    return ticks_per_second, total_logged, events
+
+def read_serial(port, baud):
+    import serial
+    with serial.Serial(port, baud, timeout=10) as connection:
+        data = b''
+        while b'SMTR' not in data:
+            chunk = connection.read(256)
+            if not chunk:
+                raise ValueError('timed out waiting for dump')
+            data = (data + chunk)[-1024:]
+        data = data[data.find(b'SMTR'):]
+        while len(data) < HEADER_SIZE:
+            data += connection.read(HEADER_SIZE - len(data))
+        count = struct.unpack_from(HEADER_FORMAT, data)[3]
+        needed = HEADER_SIZE + count * EVENT_SIZE
+        while len(data) < needed:
+            chunk = connection.read(needed - len(data))
+            if not chunk:
+                raise ValueError('timed out reading dump')
+            data += chunk
+        return data
+
+def print_timeline(ticks_per_second, total_logged, events, out):
+    out.write('%d events in dump, %d logged in total (%d overwritten)\n' %
+              (len(events), total_logged, max(0, total_logged - len(events))))
+    previous = 0
+    for timestamp, event_type, arg0, arg1 in events:
+        ms = timestamp * 1000.0 / ticks_per_second
+        delta = (timestamp - previous) * 1000.0 / ticks_per_second
+        previous = timestamp
+        out.write('%12.3f ms  %+10.3f  %-20s %s\n' % (ms, delta, event_name(event_type), describe_args(event_type, arg0, arg1)))
+
+    counts = {}
+    for event in events:
+        counts[event_name(event[1])] = counts.get(event_name(event[1]), 0) + 1
+    out.write('\nsummary:\n')
+    for name in sorted(counts):
+        out.write('  %-20s %d\n' % (name, counts[name]))
+
+    frames = [e[0] for e in events if event_name(e[1]) == 'FrameStart']
+    if len(frames) > 1:
+        intervals = [(b - a) * 1000.0 / ticks_per_second for a, b in zip(frames, frames[1:])]
+        out.write('  frame interval: min %.3f ms, max %.3f ms, mean %.3f ms\n' %
+                  (min(intervals), max(intervals), sum(intervals) / len(intervals)))
+
+def write_chrome_trace(ticks_per_second, events, path):
+    trace = []
+    for timestamp, event_type, arg0, arg1 in events:
+        name = event_name(event_type)
+        us = timestamp * 1000000.0 / ticks_per_second
+        args = {'arg0': arg0, 'arg1': arg1}
+        # row calculation and swaps are spans, everything else is an instant on its own track
+        if name == 'RowCalculationStart':
+            trace.append({'name': 'rowCalculation', 'ph': 'B', 'ts': us, 'pid': 0, 'tid': 1, 'args': args})
+        elif name == 'RowCalculationEnd':
+            trace.append({'name': 'rowCalculation', 'ph': 'E', 'ts': us, 'pid': 0, 'tid': 1, 'args': args})
+        elif name in ('SwapRequested', 'SwapComplete'):
+            layer = LAYER_NAMES.get(arg0, str(arg0))
+            trace.append({'name': 'swap ' + layer, 'ph': 'B' if name == 'SwapRequested' else 'E',
+                          'ts': us, 'pid': 0, 'tid': 2 + arg0, 'args': args})
+        else:
+            trace.append({'name': name, 'ph': 'i', 's': 'p', 'ts': us, 'pid': 0, 'tid': 0, 'args': args})
+    with open(path, 'w') as f:
+        json.dump({'traceEvents': trace, 'displayTimeUnit': 'ms'}, f)
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode a SmartMatrix SMTrace dump')
+    parser.add_argument('dump', nargs='?', help='binary dump file, - for stdin')
+    parser.add_argument('--serial', help='read the dump from a serial port instead of a file')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--chrome', help='also write the events in Chrome trace format to this file')
+    options = parser.parse_args()
+
+    if options.serial:
+        data = read_serial(options.serial, options.baud)
+    elif options.dump and options.dump != '-':
+        with open(options.dump, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    try:
+        ticks_per_second, total_logged, events = parse_dump(data)
+    except ValueError as e:
+        sys.exit('smtrace_decode: %s' % e)
+
+    print_timeline(ticks_per_second, total_logged, events, sys.stdout)
+    if options.chrome:
+        write_chrome_trace(ticks_per_second, events, options.chrome)
+
+if __name__ == '__main__':
+    main()
@@ -40,6 +40,10 @@ void cbWrite(CircularBuffer *cb) {
         ++ cb->count;
 }
 
+int cbGetCount(CircularBuffer *cb) {
+    return cb->count;
+}
+
 int cbGetNextRead(CircularBuffer *cb) {
     return cb->start;
 }
@@ -22,6 +22,9 @@ int cbGetNextWrite(CircularBuffer *cb);
 // mark next element as written
 void cbWrite(CircularBuffer *cb);
 
+// returns number of elements waiting to be read
+int cbGetCount(CircularBuffer *cb);
+
 // returns index of next element to read
 int cbGetNextRead(CircularBuffer *cb);
 
@@ -21,8 +21,29 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 #include "Layer.h"
 
+SM_Layer::SM_Layer() {
+    nextLayer = NULL;
+    pendingNextLayer = NULL;
+    enabled = true;
+    visible = true;
+    clipEnabled = false;
+    clipRequested = false;
+    layerBrightness = 255;
+    brightnessRequested = false;
+    fadeFramesLeft = 0;
+    // covers nothing until the first updateClip()
+    refreshX0 = refreshY0 = 1;
+    refreshX1 = refreshY1 = 0;
+    staticContent = false;
+    contentChanged = true;
+    memset(dirtyRows, 0x00, sizeof(dirtyRows));
+}
+
 void SM_Layer::setRotation(rotationDegrees newrotation) {
     rotation = newrotation;
 
@@ -33,8 +54,264 @@ void SM_Layer::setRotation(rotationDegrees newrotation) {
         localWidth = matrixHeight;
         localHeight = matrixWidth;
     }
+
+    invalidate();
 }
 
 void SM_Layer::setRefreshRate(uint8_t newRefreshRate) {
     refreshRate = newRefreshRate;
 }
+
+void SM_Layer::setEnabled(bool isEnabled) {
+    enabled = isEnabled;
+}
+
+bool SM_Layer::isEnabled(void) {
+    return enabled;
+}
+
+bool SM_Layer::updateVisibility(void) {
+    if(visible != enabled) {
+        visible = enabled;
+        // rows the layer covered, or will cover, change on the panel
+        invalidate();
+    }
+    return visible;
+}
+
+void SM_Layer::setClipRect(int16_t x, int16_t y, uint16_t width, uint16_t height) {
+    // withdraw any earlier request while the rectangle is written, so updateClip() never takes half of it
+    clipRequested = false;
+    // an empty rectangle is kept empty: x1 < x0
+    requestedClipX0 = x;
+    requestedClipY0 = y;
+    requestedClipX1 = x + (int16_t)width - 1;
+    requestedClipY1 = y + (int16_t)height - 1;
+    requestedClipEnabled = true;
+    clipRequested = true;
+}
+
+void SM_Layer::clearClipRect(void) {
+    clipRequested = false;
+    requestedClipEnabled = false;
+    clipRequested = true;
+}
+
+bool SM_Layer::getContentBounds(int16_t & x0, int16_t & y0, int16_t & x1, int16_t & y1) {
+    x0 = 0;
+    y0 = 0;
+    x1 = (usesRotation() ? localWidth : matrixWidth) - 1;
+    y1 = (usesRotation() ? localHeight : matrixHeight) - 1;
+    return true;
+}
+
+void SM_Layer::updateClip(void) {
+    int16_t x0, y0, x1, y1;
+    uint16_t oldY0 = refreshY0, oldY1 = refreshY1;
+    uint16_t oldX0 = refreshX0, oldX1 = refreshX1;
+    rotationDegrees clipRotation = usesRotation() ? rotation : rotation0;
+    int16_t width = usesRotation() ? localWidth : matrixWidth;
+    int16_t height = usesRotation() ? localHeight : matrixHeight;
+
+    if(clipRequested) {
+        clipX0 = requestedClipX0;
+        clipY0 = requestedClipY0;
+        clipX1 = requestedClipX1;
+        clipY1 = requestedClipY1;
+        clipEnabled = requestedClipEnabled;
+        clipRequested = false;
+    }
+
+    bool empty = !getContentBounds(x0, y0, x1, y1);
+
+    if(clipEnabled) {
+        if(clipX0 > x0) x0 = clipX0;
+        if(clipY0 > y0) y0 = clipY0;
+        if(clipX1 < x1) x1 = clipX1;
+        if(clipY1 < y1) y1 = clipY1;
+    }
+
+    if(x0 < 0) x0 = 0;
+    if(y0 < 0) y0 = 0;
+    if(x1 >= width) x1 = width - 1;
+    if(y1 >= height) y1 = height - 1;
+
+    if(empty || x1 < x0 || y1 < y0) {
+        refreshX0 = refreshY0 = 1;
+        refreshX1 = refreshY1 = 0;
+    } else {
+        // the corners in hardware coordinates, the same mapping as drawing a pixel
+        switch(clipRotation) {
+          case rotation180:
+            refreshX0 = (matrixWidth - 1) - x1;
+            refreshX1 = (matrixWidth - 1) - x0;
+            refreshY0 = (matrixHeight - 1) - y1;
+            refreshY1 = (matrixHeight - 1) - y0;
+            break;
+          case rotation90:
+            refreshX0 = (matrixWidth - 1) - y1;
+            refreshX1 = (matrixWidth - 1) - y0;
+            refreshY0 = x0;
+            refreshY1 = x1;
+            break;
+          case rotation270:
+            refreshX0 = y0;
+            refreshX1 = y1;
+            refreshY0 = (matrixHeight - 1) - x1;
+            refreshY1 = (matrixHeight - 1) - x0;
+            break;
+          default:
+            refreshX0 = x0;
+            refreshX1 = x1;
+            refreshY0 = y0;
+            refreshY1 = y1;
+            break;
+        }
+    }
+
+    // rows the layer stopped covering, or started covering, change on the panel
+    if(refreshX0 != oldX0 || refreshX1 != oldX1 || refreshY0 != oldY0 || refreshY1 != oldY1) {
+        if(oldY0 <= oldY1)
+            markRowsDirty(oldY0, oldY1);
+        if(refreshY0 <= refreshY1)
+            markRowsDirty(refreshY0, refreshY1);
+    }
+}
+
+void SM_Layer::setBrightness(uint8_t brightness) {
+    fadeTo(brightness, 0);
+}
+
+void SM_Layer::fadeTo(uint8_t brightness, uint16_t frames) {
+    requestedBrightness = brightness;
+    requestedFadeFrames = frames;
+    brightnessRequested = true;
+}
+
+uint8_t SM_Layer::getBrightness(void) {
+    return layerBrightness;
+}
+
+bool SM_Layer::isFading(void) {
+    return brightnessRequested || fadeFramesLeft;
+}
+
+void SM_Layer::updateBrightness(void) {
+    uint8_t brightness = layerBrightness;
+
+    if(brightnessRequested) {
+        brightnessRequested = false;
+        fadeTarget = requestedBrightness;
+        fadeFramesLeft = requestedFadeFrames;
+        fadeBrightness = layerBrightness << 8;
+
+        int32_t distance = (fadeTarget << 8) - fadeBrightness;
+        // a fade can't take more steps than there are 8.8 fixed point values between the two brightnesses
+        if(fadeFramesLeft > abs(distance))
+            fadeFramesLeft = abs(distance);
+        if(fadeFramesLeft)
+            fadeStep = distance / fadeFramesLeft;
+        else
+            layerBrightness = fadeTarget;
+    }
+
+    if(fadeFramesLeft) {
+        // the last step lands on the target exactly
+        if(--fadeFramesLeft)
+            fadeBrightness += fadeStep;
+        else
+            fadeBrightness = fadeTarget << 8;
+        layerBrightness = fadeBrightness >> 8;
+    }
+
+    if(layerBrightness != brightness)
+        invalidate();
+}
+
+void SM_Layer::setStatic(bool isStatic) {
+    staticContent = isStatic;
+    invalidate();
+}
+
+bool SM_Layer::isStatic(void) {
+    return staticContent;
+}
+
+void SM_Layer::invalidate(void) {
+    contentChanged = true;
+}
+
+// called by the refresh code once per frame, layers only ever set bits so a change made while this runs is at worst reported twice
+bool SM_Layer::takeDirtyRows(uint8_t rows[], uint16_t numRows) {
+    int i;
+    bool dirty = false;
+
+    if(contentChanged) {
+        contentChanged = false;
+        memset(dirtyRows, 0x00, sizeof(dirtyRows));
+        memset(rows, 0xFF, (numRows + 7) / 8);
+        return true;
+    }
+
+    if(numRows > SM_LAYER_DIRTY_ROWS_MAX)
+        numRows = SM_LAYER_DIRTY_ROWS_MAX;
+
+    for(i=0; i<(numRows + 7) / 8; i++) {
+        if(!dirtyRows[i])
+            continue;
+
+        rows[i] |= dirtyRows[i];
+        dirtyRows[i] = 0x00;
+        dirty = true;
+    }
+
+    return dirty;
+}
+
+void SM_Layer::setRowBits(uint8_t rows[], uint16_t y0, uint16_t y1) {
+    uint16_t y;
+
+    if(y1 >= SM_LAYER_DIRTY_ROWS_MAX)
+        y1 = SM_LAYER_DIRTY_ROWS_MAX - 1;
+
+    for(y=y0; y<=y1; y++)
+        rows[y/8] |= 0x80 >> (y % 8);
+}
+
+void SM_Layer::markRowsDirty(uint16_t hardwareY0, uint16_t hardwareY1) {
+    if(hardwareY1 >= SM_LAYER_DIRTY_ROWS_MAX) {
+        invalidate();
+        return;
+    }
+
+    setRowBits(dirtyRows, hardwareY0, hardwareY1);
+}
+
+void SM_Layer::markRowsDirty(const uint8_t rows[]) {
+    int i;
+
+    if(matrixHeight > SM_LAYER_DIRTY_ROWS_MAX) {
+        invalidate();
+        return;
+    }
+
+    for(i=0; i<(matrixHeight + 7) / 8; i++)
+        dirtyRows[i] |= rows[i];
+}
+
+void SM_Layer::markLocalRowsDirty(int16_t localY0, int16_t localY1) {
+    if(localY0 < 0)
+        localY0 = 0;
+    if(localY1 >= localHeight)
+        localY1 = localHeight - 1;
+    if(localY1 < localY0)
+        return;
+
+    // local rows run across the hardware rows when rotated 90 or 270 degrees
+    if(rotation == rotation0)
+        markRowsDirty(localY0, localY1);
+    else if(rotation == rotation180)
+        markRowsDirty((matrixHeight - 1) - localY1, (matrixHeight - 1) - localY0);
+    else
+        invalidate();
+}
@@ -26,26 +26,110 @@
 
 #include "MatrixCommon.h"
 
+// dirty rows are tracked with a bit per hardware row, a change to a row past this marks the whole layer dirty
+#define SM_LAYER_DIRTY_ROWS_MAX     256
+
 class SM_Layer {
     public:
-        virtual void frameRefreshCallback();
+        SM_Layer();
+
+        virtual void frameRefreshCallback() = 0;
 
         // fills refreshRow with matrixWidth values - hardwareY is < matrixHeight, not localHeight
-        virtual void fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]);
-        virtual void fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]);
+        virtual void fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]) = 0;
+        virtual void fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]) = 0;
 
         void setRotation(rotationDegrees newrotation);
         virtual void setRefreshRate(uint8_t newRefreshRate);
 
+        // a static layer's refresh rows can be cached by the refresh code (see SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED)
+        // the layer marks the rows it changes dirty, or calls invalidate() to mark all rows, and those rows are rebuilt on the next frame
+        void setStatic(bool isStatic);
+        bool isStatic(void);
+        void invalidate(void);
+        // used by the refresh code: sets the bits of rows marked dirty since the last call (bit 0x80 >> (y%8) of rows[y/8]), returns true if any were
+        bool takeDirtyRows(uint8_t rows[], uint16_t numRows);
+
+        // a disabled layer isn't composited at all, but its frameRefreshCallback() still runs so swaps and other changes
+        // waiting for a new frame complete.  The change takes effect at the start of the next frame
+        void setEnabled(bool enabled);
+        bool isEnabled(void);
+        // used by the refresh code at the start of each frame: applies setEnabled(), returns true if the layer is composited this frame
+        bool updateVisibility(void);
+        bool isVisible(void) { return visible; }
+
+        // limits the layer to a rectangle in local coordinates (hardware coordinates for a layer that ignores rotation,
+        // see usesRotation()), pixels outside it aren't drawn.  The refresh code doesn't
+        // ask the layer for rows outside the rectangle and only for the columns inside it, so a small overlay costs
+        // refresh time in proportion to its area.  Takes effect at the start of the next frame
+        void setClipRect(int16_t x, int16_t y, uint16_t width, uint16_t height);
+        void clearClipRect(void);
+        // used by the refresh code at the start of each frame: works out the hardware rows and columns the layer covers
+        // from the clip rectangle and getContentBounds()
+        void updateClip(void);
+        bool coversRow(uint16_t hardwareY) { return hardwareY >= refreshY0 && hardwareY <= refreshY1; }
+
+        // scales the layer's colors, 255 is full brightness.  Layers fold the brightness into their color correction LUT
+        // or colors once per frame, so it doesn't cost anything per pixel.  fadeTo() changes the brightness a step each
+        // frame until it reaches the new value.  Both take effect at the start of the next frame
+        void setBrightness(uint8_t brightness);
+        void fadeTo(uint8_t brightness, uint16_t frames);
+        uint8_t getBrightness(void);
+        bool isFading(void);
+        // used by the refresh code at the start of each frame: applies setBrightness() and steps a fade
+        void updateBrightness(void);
+
         SM_Layer * nextLayer;
+        // the order the next frame will use, see SmartMatrix3::insertLayer()
+        SM_Layer * pendingNextLayer;
 
     protected:
         rotationDegrees rotation;
         uint16_t matrixWidth, matrixHeight;
         uint16_t localWidth, localHeight;
         uint8_t refreshRate;
-        
+
+        // fillRefreshRow() only writes refreshRow[refreshX0] to refreshRow[refreshX1], set by updateClip()
+        uint16_t refreshX0, refreshX1;
+        // the brightness for this frame, set by updateBrightness()
+        uint8_t layerBrightness;
+        // the part of the local screen the layer can draw on (inclusive), returns false if it's empty.  Layers that
+        // know their content only covers part of the screen override this, the default is the whole screen
+        virtual bool getContentBounds(int16_t & x0, int16_t & y0, int16_t & x1, int16_t & y1);
+        // layers that place their pixels in hardware coordinates whatever the screen rotation override this to return
+        // false, so the clip rectangle and content bounds aren't rotated either
+        virtual bool usesRotation(void) { return true; }
+
+        // hardwareY0-hardwareY1 (inclusive) changed
+        void markRowsDirty(uint16_t hardwareY0, uint16_t hardwareY1);
+        // local rows localY0-localY1 (inclusive) changed, converted to hardware rows using the current rotation
+        void markLocalRowsDirty(int16_t localY0, int16_t localY1);
+        // for layers tracking damage before it's visible: sets rows y0-y1 in a SM_LAYER_DIRTY_ROWS_MAX bit bitmap
+        static void setRowBits(uint8_t rows[], uint16_t y0, uint16_t y1);
+        // marks all rows set in a SM_LAYER_DIRTY_ROWS_MAX bit bitmap of hardware rows
+        void markRowsDirty(const uint8_t rows[]);
+
     private:
+        volatile bool enabled;
+        bool visible;
+        bool clipEnabled;
+        int16_t clipX0, clipY0, clipX1, clipY1;
+        // setClipRect() and clearClipRect() are staged here until updateClip() takes them at the start of a frame
+        volatile bool clipRequested;
+        volatile bool requestedClipEnabled;
+        volatile int16_t requestedClipX0, requestedClipY0, requestedClipX1, requestedClipY1;
+        uint16_t refreshY0, refreshY1;
+        volatile bool brightnessRequested;
+        volatile uint8_t requestedBrightness;
+        volatile uint16_t requestedFadeFrames;
+        // brightness in 8.8 fixed point while fading
+        uint16_t fadeBrightness;
+        int32_t fadeStep;
+        uint8_t fadeTarget;
+        uint16_t fadeFramesLeft;
+        bool staticContent;
+        volatile bool contentChanged;
+        uint8_t dirtyRows[SM_LAYER_DIRTY_ROWS_MAX / 8];
 };
 
 #endif
@@ -27,6 +27,9 @@
 #include "Layer.h"
 #include "MatrixCommon.h"
 #include "MatrixFontCommon.h"
+#include "MatrixTrace.h"
+#include "MatrixFramePacing.h"
+#include "MatrixAffine.h"
 
 #define SM_BACKGROUND_OPTIONS_NONE     0
 
@@ -65,6 +68,12 @@ class SMLayerBackground : public SM_Layer {
         void drawString(int16_t x, int16_t y, const RGB& charColor, const char text[]);
         void drawString(int16_t x, int16_t y, const RGB& charColor, const RGB& backColor, const char text[]);
         void drawMonoBitmap(int16_t x, int16_t y, uint8_t width, uint8_t height, const RGB& bitmapColor, const uint8_t *bitmap);
+        // draw a bitmap rotated, scaled or skewed by transform (see MatrixAffine.h), clipped to the screen.  flags are
+        // SM_AFFINE_*, mono bitmaps are in the same format as drawMonoBitmap()
+        void drawAffineBitmap(const smAffineTransform & transform, uint16_t width, uint16_t height, const rgb24 *bitmap,
+            uint8_t flags = SM_AFFINE_NEAREST);
+        void drawAffineMonoBitmap(const smAffineTransform & transform, uint16_t width, uint16_t height,
+            const RGB& bitmapColor, const uint8_t *bitmap, uint8_t flags = SM_AFFINE_NEAREST);
 
         // reads pixel from drawing buffer, not refresh buffer
         const RGB readPixel(int16_t x, int16_t y);
@@ -75,9 +84,19 @@ class SMLayerBackground : public SM_Layer {
         RGB *getRealBackBuffer();
 
         void setFont(fontChoices newFont);
-        void setBrightness(uint8_t brightness);
         void enableColorCorrection(bool enabled);
 
+        // per-row horizontal offsets for wave and shear effects, in hardware coordinates (before rotation): row y is
+        // shown shifted right by offsets[y] pixels, wrapped around or with the uncovered pixels left transparent
+        // offsets has matrixHeight entries and is read while refreshing, the change takes effect at the next frame
+        void setRowOffsets(const int16_t offsets[], bool wrap = true);
+        bool isRowOffsetsPending(void);
+
+        // the next swapBuffers() blends from the frame on the panel to the new one over a number of frames: a cross-fade,
+        // or with thresholds (a byte per pixel, in hardware coordinates) a wipe or dissolve, each pixel switching once the
+        // transition is threshold/256 done.  swapBuffers() waits until the transition is finished
+        void setTransition(uint16_t frames, const uint8_t thresholds[] = NULL);
+
     private:
         bool ccEnabled = sizeof(RGB) <= 3 ? true : false;
 
@@ -88,6 +107,15 @@ class SMLayerBackground : public SM_Layer {
 
         RGB *getCurrentRefreshRow(uint16_t y);
 
+        template <typename RGB_OUT>
+        void fillRowWithOffset(uint16_t hardwareY, RGB_OUT refreshRow[]);
+        template <typename RGB_OUT>
+        void fillRun(uint16_t hardwareY, int sourceX, RGB_OUT refreshRow[], int x, int count);
+        template <typename RGB_OUT>
+        void fillRefreshPixels(const RGB * source, RGB_OUT refreshRow[], int count);
+        template <typename RGB_OUT>
+        void fillTransitionPixels(const RGB * incoming, const RGB * outgoing, const uint8_t * thresholds, RGB_OUT refreshRow[], int count);
+
         void getBackgroundRefreshPixel(uint16_t x, uint16_t y, RGB &refreshPixel);
         bool getForegroundRefreshPixel(uint16_t x, uint16_t y, RGB &xyPixel);
 
@@ -96,10 +124,15 @@ class SMLayerBackground : public SM_Layer {
         void drawHardwareVLine(uint16_t x, uint16_t y0, uint16_t y1, const RGB& color);
         void bresteepline(int16_t x3, int16_t y3, int16_t x4, int16_t y4, const RGB& color);
         void fillFlatSideTriangleInt(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const RGB& color);
+        template <typename SAMPLER>
+        void drawAffine(const smAffineTransform & transform, uint16_t width, uint16_t height, const SAMPLER & sampler);
         // todo: move somewhere else
         static bool getBitmapPixelAtXY(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const uint8_t *bitmap);
 
-        uint8_t backgroundBrightness = 255;
+        // color correction and brightness, see frameRefreshCallback()
+        color_chan_t colorCorrectionLUT[256];
+        uint16_t colorCorrectionLUTKey = 0xFFFF;
+        bool lutEnabled = false;
 
         // keeping track of drawing buffers
         static unsigned char currentDrawBuffer;
@@ -107,6 +140,30 @@ class SMLayerBackground : public SM_Layer {
         static volatile bool swapPending;
         static bool swapWithCopy;
         void handleBufferSwap(void);
+
+        // offsets used by the refresh, and offsets waiting for the next frame
+        const int16_t * rowOffsets = NULL;
+        bool rowOffsetsWrap = true;
+        const int16_t * pendingRowOffsets = NULL;
+        bool pendingRowOffsetsWrap = true;
+        volatile bool rowOffsetsPending = false;
+        void handleRowOffsetsChange(void);
+
+        // transition for the next swap, and the transition running: the outgoing frame is in the drawing buffer
+        volatile uint16_t requestedTransitionFrames = 0;
+        const uint8_t * requestedTransitionThresholds = NULL;
+        bool transitionActive = false;
+        uint16_t transitionFrames;
+        uint16_t transitionFrame;
+        uint16_t transitionMix;             // 0-256, how far the transition is
+        const uint8_t * transitionThresholds;
+        void handleTransition(void);
+
+        // hardware rows drawn since the last swap, and rows the pending (or last) swap changes on the panel
+        uint8_t drawDamage[SM_LAYER_DIRTY_ROWS_MAX / 8];
+        uint8_t swapDamage[SM_LAYER_DIRTY_ROWS_MAX / 8];
+        // true if the drawing buffer was a copy of the refresh buffer before drawing started
+        bool drawBufferCopied;
 };
 
 #include "Layer_Background_Impl.h"
@@ -23,8 +23,6 @@
 
 #include <stdlib.h>     
 
-static color_chan_t backgroundColorCorrectionLUT[256];
-
 template <typename RGB, unsigned int optionFlags>
 unsigned char SMLayerBackground<RGB, optionFlags>::currentDrawBuffer = 0;
 template <typename RGB, unsigned int optionFlags>
@@ -42,53 +40,129 @@ SMLayerBackground<RGB, optionFlags>::SMLayerBackground(RGB * buffer, uint16_t wi
 
     currentDrawBufferPtr = &backgroundBuffer[0 * (this->matrixWidth * this->matrixHeight)];
     currentRefreshBufferPtr = &backgroundBuffer[1 * (this->matrixWidth * this->matrixHeight)];
+
+    // first swap changes every row
+    memset(drawDamage, 0xFF, sizeof(drawDamage));
+    memset(swapDamage, 0x00, sizeof(swapDamage));
+    drawBufferCopied = true;
 }
 
 template <typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::frameRefreshCallback(void) {
     handleBufferSwap();
+    handleTransition();
+    handleRowOffsetsChange();
 
-    calculateBackgroundLUT(backgroundColorCorrectionLUT, backgroundBrightness);
+    // the LUT holds the layer's color correction and brightness
+    updateLayerLUT(colorCorrectionLUT, colorCorrectionLUTKey, this->layerBrightness, this->ccEnabled);
+    // without color correction at full brightness, pixels are copied as they are.  rgb48 pixels can't be looked up
+    lutEnabled = this->ccEnabled || (sizeof(RGB) <= 3 && this->layerBrightness < 255);
 }
 
 template <typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]) {
+    fillRowWithOffset(hardwareY, refreshRow);
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]) {
+    fillRowWithOffset(hardwareY, refreshRow);
+}
+
+// the row offset only changes where the copy starts, the pixels are still copied in one or two runs
+template <typename RGB, unsigned int optionFlags> template <typename RGB_OUT>
+void SMLayerBackground<RGB, optionFlags>::fillRowWithOffset(uint16_t hardwareY, RGB_OUT refreshRow[]) {
+    int width = this->matrixWidth;
+    int offset = rowOffsets ? rowOffsets[hardwareY] : 0;
+
+    if(!offset) {
+        fillRun(hardwareY, 0, refreshRow, 0, width);
+    } else if(rowOffsetsWrap) {
+        offset %= width;
+        if(offset < 0)
+            offset += width;
+        fillRun(hardwareY, 0, refreshRow, offset, width - offset);
+        fillRun(hardwareY, width - offset, refreshRow, 0, offset);
+    } else if(offset > 0) {
+        // pixels shifted in from the left are transparent
+        if(offset < width)
+            fillRun(hardwareY, 0, refreshRow, offset, width - offset);
+    } else {
+        if(-offset < width)
+            fillRun(hardwareY, -offset, refreshRow, 0, width + offset);
+    }
+}
+
+// count pixels starting at sourceX in row hardwareY of the buffer, written to refreshRow starting at column x, blended
+// with the outgoing frame during a transition.  Only the columns inside the clip rectangle are written
+template <typename RGB, unsigned int optionFlags> template <typename RGB_OUT>
+void SMLayerBackground<RGB, optionFlags>::fillRun(uint16_t hardwareY, int sourceX, RGB_OUT refreshRow[], int x, int count) {
+    int skip = this->refreshX0 - x;
+    if(skip > 0) {
+        sourceX += skip;
+        x += skip;
+        count -= skip;
+    }
+    if(x + count > this->refreshX1 + 1)
+        count = this->refreshX1 + 1 - x;
+    if(count <= 0)
+        return;
+
+    int start = (hardwareY * this->matrixWidth) + sourceX;
+    refreshRow = &refreshRow[x];
+
+    if(transitionActive) {
+        fillTransitionPixels(&currentRefreshBufferPtr[start], &currentDrawBufferPtr[start],
+            transitionThresholds ? &transitionThresholds[start] : NULL, refreshRow, count);
+    } else {
+        fillRefreshPixels(&currentRefreshBufferPtr[start], refreshRow, count);
+    }
+}
+
+template <typename RGB, unsigned int optionFlags> template <typename RGB_OUT>
+void SMLayerBackground<RGB, optionFlags>::fillRefreshPixels(const RGB * source, RGB_OUT refreshRow[], int count) {
     RGB currentPixel;
     int i;
 
-    if(this->ccEnabled) {
-        for(i=0; i<this->matrixWidth; i++) {
-            currentPixel = currentRefreshBufferPtr[(hardwareY * this->matrixWidth) + i];
-            // load background pixel with color correction
-            refreshRow[i] = rgb48(backgroundColorCorrectionLUT[currentPixel.red],
-                backgroundColorCorrectionLUT[currentPixel.green],
-                backgroundColorCorrectionLUT[currentPixel.blue]);
+    if(lutEnabled) {
+        for(i=0; i<count; i++) {
+            currentPixel = source[i];
+            // load background pixel with color correction and brightness
+            refreshRow[i] = rgb48(colorCorrectionLUT[currentPixel.red],
+                colorCorrectionLUT[currentPixel.green],
+                colorCorrectionLUT[currentPixel.blue]);
         }
     } else {
-        for(i=0; i<this->matrixWidth; i++) {
-            currentPixel = currentRefreshBufferPtr[(hardwareY * this->matrixWidth) + i];
+        for(i=0; i<count; i++) {
+            currentPixel = source[i];
             // load background pixel without color correction
             refreshRow[i] = currentPixel;
         }
     }
 }
 
-template <typename RGB, unsigned int optionFlags>
-void SMLayerBackground<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]) {
+// a cross-fade is a multiply-add per channel, a wipe or dissolve picks one of the two frames for each pixel
+template <typename RGB, unsigned int optionFlags> template <typename RGB_OUT>
+void SMLayerBackground<RGB, optionFlags>::fillTransitionPixels(const RGB * incoming, const RGB * outgoing, const uint8_t * thresholds, RGB_OUT refreshRow[], int count) {
     RGB currentPixel;
+    int32_t mix = transitionMix;
     int i;
 
-    if(this->ccEnabled) {
-        for(i=0; i<this->matrixWidth; i++) {
-            currentPixel = currentRefreshBufferPtr[(hardwareY * this->matrixWidth) + i];
-            // load background pixel with color correction
-            refreshRow[i] = rgb48(backgroundColorCorrectionLUT[currentPixel.red],
-                backgroundColorCorrectionLUT[currentPixel.green],
-                backgroundColorCorrectionLUT[currentPixel.blue]);
+    for(i=0; i<count; i++) {
+        if(thresholds) {
+            currentPixel = (thresholds[i] < mix) ? incoming[i] : outgoing[i];
+        } else {
+            currentPixel = RGB(outgoing[i].red + (((incoming[i].red - outgoing[i].red) * mix) >> 8),
+                outgoing[i].green + (((incoming[i].green - outgoing[i].green) * mix) >> 8),
+                outgoing[i].blue + (((incoming[i].blue - outgoing[i].blue) * mix) >> 8));
         }
-    } else {
-        for(i=0; i<this->matrixWidth; i++) {
-            currentPixel = currentRefreshBufferPtr[(hardwareY * this->matrixWidth) + i];
+
+        if(lutEnabled) {
+            // load background pixel with color correction and brightness
+            refreshRow[i] = rgb48(colorCorrectionLUT[currentPixel.red],
+                colorCorrectionLUT[currentPixel.green],
+                colorCorrectionLUT[currentPixel.blue]);
+        } else {
             // load background pixel without color correction
             refreshRow[i] = currentPixel;
         }
@@ -122,6 +196,8 @@ void SMLayerBackground<RGB, optionFlags>::drawPixel(int16_t x, int16_t y, const
     }
 
     currentDrawBufferPtr[(hwy * this->matrixWidth) + hwx] = color;
+    if(hwy < SM_LAYER_DIRTY_ROWS_MAX)
+        drawDamage[hwy/8] |= 0x80 >> (hwy % 8);
 }
 
 #define SWAPint(X,Y) { \
@@ -138,6 +214,7 @@ void SMLayerBackground<RGB, optionFlags>::drawHardwareHLine(uint16_t x0, uint16_
     for (i = x0; i <= x1; i++) {
         currentDrawBufferPtr[(y * this->matrixWidth) + i] = color;
     }
+    this->setRowBits(drawDamage, y, y);
 }
 
 // x, y0, and y1 must be in bounds (0-this->localWidth/Height-1), y1 > y0
@@ -148,6 +225,7 @@ void SMLayerBackground<RGB, optionFlags>::drawHardwareVLine(uint16_t x, uint16_t
     for (i = y0; i <= y1; i++) {
         currentDrawBufferPtr[(i * this->matrixWidth) + x] = color;
     }
+    this->setRowBits(drawDamage, y0, y1);
 }
 
 template <typename RGB, unsigned int optionFlags>
@@ -844,6 +922,221 @@ void SMLayerBackground<RGB, optionFlags>::drawMonoBitmap(int16_t x, int16_t y, u
     }
 }
 
+// samplers for drawAffine(): read the bitmap at source position (u, v) in 16.16 fixed point, which drawAffine() has
+// already clipped to the bitmap, and write the destination pixel
+// bilinear samples are centered on the pixel and clamped at the edges, with 8-bit weights adding up to 65536
+#define AFFINE_BILINEAR_SETUP(width, height) \
+    int32_t sampleX = u - SM_AFFINE_ONE / 2, sampleY = v - SM_AFFINE_ONE / 2; \
+    int x0 = sampleX < 0 ? 0 : (sampleX >> 16), y0 = sampleY < 0 ? 0 : (sampleY >> 16); \
+    int x1 = x0 + 1 < (width) && sampleX >= 0 ? x0 + 1 : x0; \
+    int y1 = y0 + 1 < (height) && sampleY >= 0 ? y0 + 1 : y0; \
+    uint32_t fx = (sampleX >> 8) & 0xff, fy = (sampleY >> 8) & 0xff; \
+    uint32_t weights[4] = { (256 - fx) * (256 - fy), fx * (256 - fy), (256 - fx) * fy, fx * fy };
+
+template <typename RGB, bool bilinear, bool transparent>
+struct smAffineRgb24Sampler {
+    const rgb24 * bitmap;
+    uint16_t width;
+    uint16_t height;
+
+    inline void operator()(RGB & dest, int32_t u, int32_t v) const {
+        if(!bilinear) {
+            const rgb24 & pixel = bitmap[(v >> 16) * width + (u >> 16)];
+            if(transparent && !pixel.red && !pixel.green && !pixel.blue)
+                return;
+            dest = pixel;
+            return;
+        }
+
+        AFFINE_BILINEAR_SETUP(width, height);
+        const rgb24 * pixels[4] = { &bitmap[y0 * width + x0], &bitmap[y0 * width + x1],
+            &bitmap[y1 * width + x0], &bitmap[y1 * width + x1] };
+        uint32_t red = 0, green = 0, blue = 0, alpha = 0;
+        for(int i = 0; i < 4; i++) {
+            red += pixels[i]->red * weights[i];
+            green += pixels[i]->green * weights[i];
+            blue += pixels[i]->blue * weights[i];
+            if(transparent && (pixels[i]->red || pixels[i]->green || pixels[i]->blue))
+                alpha += weights[i];
+        }
+
+        if(!transparent || alpha == 0x10000) {
+            dest = rgb24(red >> 16, green >> 16, blue >> 16);
+        } else if(alpha) {
+            // black pixels add nothing to the sum, so it's the color already multiplied by alpha
+            RGB color;
+            color = rgb24(red >> 16, green >> 16, blue >> 16);
+            dest.red = ((dest.red * (0x10000 - alpha)) >> 16) + color.red;
+            dest.green = ((dest.green * (0x10000 - alpha)) >> 16) + color.green;
+            dest.blue = ((dest.blue * (0x10000 - alpha)) >> 16) + color.blue;
+        }
+    }
+};
+
+template <typename RGB, bool bilinear>
+struct smAffineMonoSampler {
+    const uint8_t * bitmap;
+    uint16_t width;
+    uint16_t height;
+    RGB color;
+
+    inline bool bit(int x, int y) const {
+        // same layout as drawMonoBitmap()
+        return bitmap[(y * ((width / 8) + 1)) + (x / 8)] & (0x80 >> (x % 8));
+    }
+
+    inline void operator()(RGB & dest, int32_t u, int32_t v) const {
+        if(!bilinear) {
+            if(bit(u >> 16, v >> 16))
+                dest = color;
+            return;
+        }
+
+        // blend the color over the destination by the coverage of the four nearest bits
+        AFFINE_BILINEAR_SETUP(width, height);
+        uint32_t alpha = (bit(x0, y0) ? weights[0] : 0) + (bit(x1, y0) ? weights[1] : 0) +
+            (bit(x0, y1) ? weights[2] : 0) + (bit(x1, y1) ? weights[3] : 0);
+        if(alpha == 0x10000) {
+            dest = color;
+        } else if(alpha) {
+            dest.red = (dest.red * (0x10000 - alpha) + color.red * alpha) >> 16;
+            dest.green = (dest.green * (0x10000 - alpha) + color.green * alpha) >> 16;
+            dest.blue = (dest.blue * (0x10000 - alpha) + color.blue * alpha) >> 16;
+        }
+    }
+};
+
+// not min() and max(), which are macros on some Arduino cores
+static inline int64_t affineMin(int64_t x, int64_t y) {
+    return x < y ? x : y;
+}
+
+static inline int64_t affineMax(int64_t x, int64_t y) {
+    return x > y ? x : y;
+}
+
+static inline int64_t affineFloorDivide(int64_t numerator, int64_t denominator) {
+    int64_t quotient = numerator / denominator;
+    if((numerator % denominator) && ((numerator < 0) != (denominator < 0)))
+        quotient--;
+    return quotient;
+}
+
+// narrows [first, last] to the steps k where 0 <= start + step * k < limit
+static inline void affineClipSpan(int64_t start, int64_t step, int64_t limit, int64_t & first, int64_t & last) {
+    if(step > 0) {
+        first = affineMax(first, -affineFloorDivide(start, step));
+        last = affineMin(last, affineFloorDivide(limit - 1 - start, step));
+    } else if(step < 0) {
+        first = affineMax(first, -affineFloorDivide(start - (limit - 1), step));
+        last = affineMin(last, affineFloorDivide(-start, step));
+    } else if(start < 0 || start >= limit) {
+        last = first - 1;
+    }
+}
+
+// inverts the transform and walks the hardware rows the bitmap covers: the source position at each end of the row is
+// solved for directly, and stepped between them with two additions per pixel
+template <typename RGB, unsigned int optionFlags> template <typename SAMPLER>
+void SMLayerBackground<RGB, optionFlags>::drawAffine(const smAffineTransform & transform, uint16_t width, uint16_t height,
+  const SAMPLER & sampler) {
+    const int64_t one = SM_AFFINE_ONE;
+    const int64_t hardwareWidth = this->matrixWidth * one, hardwareHeight = this->matrixHeight * one;
+    int64_t a, b, c, d, tx, ty;
+
+    // transform from the source to hardware coordinates, following the screen transform with the rotation
+    if (this->rotation == rotation0) {
+        a = transform.a;    b = transform.b;    tx = transform.tx;
+        c = transform.c;    d = transform.d;    ty = transform.ty;
+    } else if (this->rotation == rotation180) {
+        a = -transform.a;   b = -transform.b;   tx = hardwareWidth - transform.tx;
+        c = -transform.c;   d = -transform.d;   ty = hardwareHeight - transform.ty;
+    } else if (this->rotation == rotation90) {
+        a = -transform.c;   b = -transform.d;   tx = hardwareWidth - transform.ty;
+        c = transform.a;    d = transform.b;    ty = transform.tx;
+    } else { /* if (rotation == rotation270)*/
+        a = transform.c;    b = transform.d;    tx = transform.ty;
+        c = -transform.a;   d = -transform.b;   ty = hardwareHeight - transform.tx;
+    }
+
+    int64_t determinant = a * d - b * c;
+    if(!determinant || !width || !height)
+        return;
+
+    // hardware pixels the bitmap's corners enclose, clipped to the screen
+    int64_t minX = tx, maxX = tx, minY = ty, maxY = ty;
+    for(int corner = 1; corner < 4; corner++) {
+        int64_t x = (corner & 1) ? width : 0, y = (corner & 2) ? height : 0;
+        minX = affineMin(minX, a * x + b * y + tx);
+        maxX = affineMax(maxX, a * x + b * y + tx);
+        minY = affineMin(minY, c * x + d * y + ty);
+        maxY = affineMax(maxY, c * x + d * y + ty);
+    }
+    int64_t firstColumn = affineMax(affineFloorDivide(minX, one), 0);
+    int64_t lastColumn = affineMin(affineFloorDivide(maxX, one), this->matrixWidth - 1);
+    int64_t firstRow = affineMax(affineFloorDivide(minY, one), 0);
+    int64_t lastRow = affineMin(affineFloorDivide(maxY, one), this->matrixHeight - 1);
+    if(firstColumn > lastColumn || firstRow > lastRow)
+        return;
+
+    // inverse, the source step for one hardware pixel right (du, dv) and down (duRow, dvRow)
+    int64_t du = d * (one << 16) / determinant;
+    int64_t duRow = -b * (one << 16) / determinant;
+    int64_t dv = -c * (one << 16) / determinant;
+    int64_t dvRow = a * (one << 16) / determinant;
+
+    // source position at the center of the first pixel in the first row
+    int64_t x = firstColumn * one + one / 2 - tx, y = firstRow * one + one / 2 - ty;
+    int64_t uRow = (du * x + duRow * y) >> 16;
+    int64_t vRow = (dv * x + dvRow * y) >> 16;
+    const int64_t sourceWidth = width * one, sourceHeight = height * one;
+
+    for(int64_t row = firstRow; row <= lastRow; row++, uRow += duRow, vRow += dvRow) {
+        int64_t first = 0, last = lastColumn - firstColumn;
+        affineClipSpan(uRow, du, sourceWidth, first, last);
+        affineClipSpan(vRow, dv, sourceHeight, first, last);
+
+        int count = last - first + 1;
+        if(count <= 0)
+            continue;
+
+        // the span is clipped to the bitmap, so the rest is 32-bit: with more than one pixel the steps are smaller
+        // than the bitmap, and with one the steps aren't used
+        RGB * dest = &currentDrawBufferPtr[row * this->matrixWidth + firstColumn + first];
+        int32_t u = uRow + du * first, v = vRow + dv * first;
+        int32_t stepU = (count > 1) ? (int32_t)du : 0, stepV = (count > 1) ? (int32_t)dv : 0;
+        for(int i = 0; i < count; i++, u += stepU, v += stepV)
+            sampler(*dest++, u, v);
+    }
+
+    this->setRowBits(drawDamage, firstRow, lastRow);
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::drawAffineBitmap(const smAffineTransform & transform, uint16_t width, uint16_t height,
+  const rgb24 *bitmap, uint8_t flags) {
+    if(flags & SM_AFFINE_BILINEAR) {
+        if(flags & SM_AFFINE_TRANSPARENT_BLACK)
+            drawAffine(transform, width, height, smAffineRgb24Sampler<RGB, true, true>{bitmap, width, height});
+        else
+            drawAffine(transform, width, height, smAffineRgb24Sampler<RGB, true, false>{bitmap, width, height});
+    } else {
+        if(flags & SM_AFFINE_TRANSPARENT_BLACK)
+            drawAffine(transform, width, height, smAffineRgb24Sampler<RGB, false, true>{bitmap, width, height});
+        else
+            drawAffine(transform, width, height, smAffineRgb24Sampler<RGB, false, false>{bitmap, width, height});
+    }
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::drawAffineMonoBitmap(const smAffineTransform & transform, uint16_t width, uint16_t height,
+  const RGB& bitmapColor, const uint8_t *bitmap, uint8_t flags) {
+    if(flags & SM_AFFINE_BILINEAR)
+        drawAffine(transform, width, height, smAffineMonoSampler<RGB, true>{bitmap, width, height, bitmapColor});
+    else
+        drawAffine(transform, width, height, smAffineMonoSampler<RGB, false>{bitmap, width, height, bitmapColor});
+}
+
 template <typename RGB, unsigned int optionFlags>
 bool SMLayerBackground<RGB, optionFlags>::isSwapPending(void) {
     return swapPending;
@@ -851,7 +1144,7 @@ bool SMLayerBackground<RGB, optionFlags>::isSwapPending(void) {
 
 template <typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::handleBufferSwap(void) {
-    if (!swapPending)
+    if (!swapPending || transitionActive)
         return;
 
     unsigned char newDrawBuffer = currentRefreshBuffer;
@@ -862,47 +1155,135 @@ void SMLayerBackground<RGB, optionFlags>::handleBufferSwap(void) {
     currentRefreshBufferPtr = &backgroundBuffer[currentRefreshBuffer * (this->matrixWidth * this->matrixHeight)];
     currentDrawBufferPtr = &backgroundBuffer[currentDrawBuffer * (this->matrixWidth * this->matrixHeight)];
 
-    swapPending = false;
+    // with a transition, the swap stays pending until the transition is finished
+    if(requestedTransitionFrames) {
+        transitionFrames = requestedTransitionFrames;
+        transitionThresholds = requestedTransitionThresholds;
+        transitionFrame = 0;
+        transitionActive = true;
+        requestedTransitionFrames = 0;
+    } else {
+        swapPending = false;
+    }
+    this->markRowsDirty(swapDamage);
+    SM_TRACE(smTraceSwapComplete, smTraceLayerBackground, 0);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapPresented(this);
+#endif
 }
 
 // waits until previous swap is complete
 // waits until current swap is complete if copy is enabled
 template <typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::swapBuffers(bool copy) {
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    uint32_t swapRequestTime = SMFramePacing::swapRequested(this, swapPending);
+#endif
     while (swapPending);
 
+    // rows that will change on the panel: rows drawn since the last swap, and rows the last swap changed if they weren't copied back
+    if(drawBufferCopied) {
+        memcpy(swapDamage, drawDamage, sizeof(swapDamage));
+    } else {
+        for(unsigned int i=0; i<sizeof(swapDamage); i++)
+            swapDamage[i] |= drawDamage[i];
+    }
+    memset(drawDamage, 0x00, sizeof(drawDamage));
+    drawBufferCopied = copy;
+    // the drawing buffer holds the outgoing frame until a transition is finished
+    bool transition = requestedTransitionFrames;
+
+    SM_TRACE(smTraceSwapRequested, smTraceLayerBackground, copy);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapQueued(this);
+#endif
     swapPending = true;
 
+    if (transition)
+        while (swapPending);
+
     if (copy) {
         while (swapPending);
-        memcpy(currentDrawBufferPtr, currentRefreshBufferPtr, sizeof(RGB) * (this->matrixWidth * this->matrixHeight));
+        memcpy((void *)currentDrawBufferPtr, (const void *)currentRefreshBufferPtr, sizeof(RGB) * (this->matrixWidth * this->matrixHeight));
     }
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapReturned(this, swapRequestTime);
+#endif
 }
 
 template <typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::copyRefreshToDrawing() {
     memcpy(currentDrawBufferPtr, currentRefreshBufferPtr, sizeof(RGB) * (this->matrixWidth * this->matrixHeight));
+    memset(drawDamage, 0x00, sizeof(drawDamage));
+    drawBufferCopied = true;
 }
 
 // return pointer to start of currentDrawBuffer, so application can do efficient loading of bitmaps
 template <typename RGB, unsigned int optionFlags>
 RGB *SMLayerBackground<RGB, optionFlags>::backBuffer(void) {
+    // the application can write anywhere in the buffer
+    this->setRowBits(drawDamage, 0, this->matrixHeight - 1);
     return currentDrawBufferPtr;
 }
 
 template<typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::setBackBuffer(RGB *newBuffer) {
   currentDrawBufferPtr = newBuffer;
+  this->setRowBits(drawDamage, 0, this->matrixHeight - 1);
 }
 
-template<typename RGB, unsigned int optionFlags>
-void SMLayerBackground<RGB, optionFlags>::setBrightness(uint8_t brightness) {
-    backgroundBrightness = brightness;
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::setTransition(uint16_t frames, const uint8_t thresholds[]) {
+    requestedTransitionThresholds = thresholds;
+    requestedTransitionFrames = frames;
+}
+
+// called every frame after handleBufferSwap(), every row changes while the transition is running
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::handleTransition(void) {
+    if (!transitionActive)
+        return;
+
+    if (++transitionFrame >= transitionFrames) {
+        transitionActive = false;
+        swapPending = false;
+    } else {
+        transitionMix = (transitionFrame * 256) / transitionFrames;
+    }
+    this->invalidate();
+}
+
+// the refresh keeps reading the old offsets until the next frame: to animate without tearing, alternate between two
+// tables, and only write to the one passed last time after isRowOffsetsPending() returns false
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::setRowOffsets(const int16_t offsets[], bool wrap) {
+    while (rowOffsetsPending);
+
+    pendingRowOffsets = offsets;
+    pendingRowOffsetsWrap = wrap;
+    rowOffsetsPending = true;
+}
+
+template <typename RGB, unsigned int optionFlags>
+bool SMLayerBackground<RGB, optionFlags>::isRowOffsetsPending(void) {
+    return rowOffsetsPending;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerBackground<RGB, optionFlags>::handleRowOffsetsChange(void) {
+    if (!rowOffsetsPending)
+        return;
+
+    rowOffsets = pendingRowOffsets;
+    rowOffsetsWrap = pendingRowOffsetsWrap;
+    rowOffsetsPending = false;
+    this->invalidate();
 }
 
 template<typename RGB, unsigned int optionFlags>
 void SMLayerBackground<RGB, optionFlags>::enableColorCorrection(bool enabled) {
     this->ccEnabled = sizeof(RGB) <= 3 ? enabled : false;
+    this->invalidate();
 }
 
 // reads pixel from drawing buffer, not refresh buffer
@@ -934,6 +1315,7 @@ const RGB SMLayerBackground<RGB, optionFlags>::readPixel(int16_t x, int16_t y) {
 
 template<typename RGB, unsigned int optionFlags>
 RGB *SMLayerBackground<RGB, optionFlags>::getRealBackBuffer() {
+  this->setRowBits(drawDamage, 0, this->matrixHeight - 1);
   return &backgroundBuffer[currentDrawBuffer * (this->matrixWidth * this->matrixHeight)];
 }
 
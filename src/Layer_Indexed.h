@@ -31,6 +31,8 @@
 
 // font
 #include "MatrixFontCommon.h"
+#include "MatrixTrace.h"
+#include "MatrixFramePacing.h"
 
 template <typename RGB, unsigned int optionFlags>
 class SMLayerIndexed : public SM_Layer {
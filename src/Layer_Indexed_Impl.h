@@ -86,21 +86,14 @@ void SMLayerIndexed<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb48
     RGB currentPixel;
     int i;
 
-    if(this->ccEnabled) {
-        for(i=0; i<this->matrixWidth; i++) {
-            if(!getPixel(i, hardwareY, currentPixel))
-                continue;
+    // once per row rather than per frame, so a row callback can change the color
+    rgb48 refreshColor = calculateLayerColor(color, this->layerBrightness, ccEnabled);
 
-            colorCorrection(currentPixel, refreshRow[i]);
-        }
-    } else {
-        for(i=0; i<this->matrixWidth; i++) {
-            if(!getPixel(i, hardwareY, currentPixel))
-                continue;
+    for(i=this->refreshX0; i<=this->refreshX1; i++) {
+        if(!getPixel(i, hardwareY, currentPixel))
+            continue;
 
-            // load background pixel without color correction
-            refreshRow[i] = currentPixel;
-        }
+        refreshRow[i] = refreshColor;
     }
 }
 
@@ -109,32 +102,27 @@ void SMLayerIndexed<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb24
     RGB currentPixel;
     int i;
 
-    if(this->ccEnabled) {
-        for(i=0; i<this->matrixWidth; i++) {
-            if(!getPixel(i, hardwareY, currentPixel))
-                continue;
+    // once per row rather than per frame, so a row callback can change the color
+    rgb48 refreshColor = calculateLayerColor(color, this->layerBrightness, ccEnabled);
 
-            colorCorrection(currentPixel, refreshRow[i]);
-        }
-    } else {
-        for(i=0; i<this->matrixWidth; i++) {
-            if(!getPixel(i, hardwareY, currentPixel))
-                continue;
+    for(i=this->refreshX0; i<=this->refreshX1; i++) {
+        if(!getPixel(i, hardwareY, currentPixel))
+            continue;
 
-            // load background pixel without color correction
-            refreshRow[i] = currentPixel;
-        }
+        refreshRow[i] = refreshColor;
     }
 }
 
 template<typename RGB, unsigned int optionFlags>
 void SMLayerIndexed<RGB, optionFlags>::setIndexedColor(uint8_t index, const RGB & newColor) {
     color = newColor;
+    this->invalidate();
 }
 
 template<typename RGB, unsigned int optionFlags>
 void SMLayerIndexed<RGB, optionFlags>::enableColorCorrection(bool enabled) {
     this->ccEnabled = sizeof(RGB) <= 3 ? enabled : false;
+    this->invalidate();
 }
 
 template <typename RGB, unsigned int optionFlags>
@@ -150,11 +138,21 @@ void SMLayerIndexed<RGB, optionFlags>::fillScreen(uint8_t index) {
 
 template <typename RGB, unsigned int optionFlags>
 void SMLayerIndexed<RGB, optionFlags>::swapBuffers(bool copy) {
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    uint32_t swapRequestTime = SMFramePacing::swapRequested(this, copyPending);
+#endif
     while (copyPending);
 
+    SM_TRACE(smTraceSwapRequested, smTraceLayerIndexed, copy);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapQueued(this);
+#endif
     copyPending = true;
 
     while (copy && copyPending);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapReturned(this, swapRequestTime);
+#endif
 }
 
 template <typename RGB, unsigned int optionFlags>
@@ -164,6 +162,11 @@ void SMLayerIndexed<RGB, optionFlags>::handleBufferCopy(void) {
 
     memcpy(&indexedBitmap[indexedRefreshBuffer*INDEXED_BUFFER_SIZE], &indexedBitmap[indexedDrawBuffer*INDEXED_BUFFER_SIZE], INDEXED_BUFFER_SIZE);
     copyPending = false;
+    this->invalidate();
+    SM_TRACE(smTraceSwapComplete, smTraceLayerIndexed, 0);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapPresented(this);
+#endif
 }
 
 template <typename RGB, unsigned int optionFlags>
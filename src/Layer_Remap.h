@@ -0,0 +1,93 @@
+/*
+ * SmartMatrix Library - Remap Layer Class
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LAYER_REMAP_H_
+#define _LAYER_REMAP_H_
+
+#include "Layer.h"
+#include "MatrixCommon.h"
+#include "MatrixTrace.h"
+#include "MatrixFramePacing.h"
+
+#define SM_REMAP_OPTIONS_NONE       0
+
+// map entry for a hardware pixel that doesn't show any canvas pixel, it's left transparent
+#define SM_REMAP_BLANK              0xFFFF
+
+/*
+  A layer for panels that aren't arranged in a rectangle (staircases, columns, cut-outs).  The sketch draws into a
+  double buffered logical canvas, and the layer shows it on the panels through a map with an entry for every
+  hardware pixel (width * height, row by row, in hardware coordinates): the index of the canvas pixel it shows
+  (y * canvasWidth + x), or SM_REMAP_BLANK.  The map is const, so it can stay in flash, and is usually generated
+  from a description of the installation with extras/tools/smremap.py.  The map already places every pixel, so the
+  layer ignores the screen rotation.
+ */
+template <typename RGB, unsigned int optionFlags>
+class SMLayerRemap : public SM_Layer {
+    public:
+        // buffer holds 2 * canvasWidth * canvasHeight pixels, map holds width * height entries
+        SMLayerRemap(RGB * buffer, uint16_t canvasWidth, uint16_t canvasHeight, const uint16_t * map, uint16_t width, uint16_t height);
+        void frameRefreshCallback();
+        void fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]);
+        void fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]);
+
+        void swapBuffers(bool copy = true);
+        bool isSwapPending(void);
+        void drawPixel(int16_t x, int16_t y, const RGB& color);
+        void fillScreen(const RGB& color);
+        // reads pixel from drawing buffer, not refresh buffer
+        const RGB readPixel(int16_t x, int16_t y);
+        // canvasWidth * canvasHeight pixels, row by row
+        RGB *backBuffer(void);
+
+        // switch to another map for the same canvas size, takes effect at the next frame
+        void setMap(const uint16_t * map);
+        void enableColorCorrection(bool enabled);
+
+    protected:
+        // the map is in hardware coordinates, so is the clip rectangle
+        bool usesRotation(void) { return false; }
+
+    private:
+        template <typename RGB_OUT>
+        void fillRemappedRow(uint16_t hardwareY, RGB_OUT refreshRow[]);
+        void handleBufferSwap(void);
+
+        bool ccEnabled = sizeof(RGB) <= 3 ? true : false;
+        // color correction and brightness, see frameRefreshCallback()
+        color_chan_t colorCorrectionLUT[256];
+        uint16_t colorCorrectionLUTKey = 0xFFFF;
+        bool lutEnabled = false;
+
+        uint16_t canvasWidth, canvasHeight;
+        RGB * drawBuffer;
+        RGB * refreshBuffer;
+        volatile bool swapPending = false;
+
+        const uint16_t * map;
+        const uint16_t * volatile pendingMap = NULL;
+};
+
+#include "Layer_Remap_Impl.h"
+
+#endif
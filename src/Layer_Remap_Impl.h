@@ -0,0 +1,174 @@
+/*
+ * SmartMatrix Library - Remap Layer Class
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#define REMAP_BUFFER_SIZE       (canvasWidth * canvasHeight)
+
+template <typename RGB, unsigned int optionFlags>
+SMLayerRemap<RGB, optionFlags>::SMLayerRemap(RGB * buffer, uint16_t canvasWidth, uint16_t canvasHeight, const uint16_t * map, uint16_t width, uint16_t height) {
+    this->canvasWidth = canvasWidth;
+    this->canvasHeight = canvasHeight;
+    drawBuffer = &buffer[0];
+    refreshBuffer = &buffer[canvasWidth * canvasHeight];
+    this->map = map;
+    this->matrixWidth = width;
+    this->matrixHeight = height;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::frameRefreshCallback(void) {
+    handleBufferSwap();
+
+    if(pendingMap) {
+        map = pendingMap;
+        pendingMap = NULL;
+        this->invalidate();
+    }
+
+    updateLayerLUT(colorCorrectionLUT, colorCorrectionLUTKey, this->layerBrightness, ccEnabled);
+    // without color correction at full brightness, pixels are copied as they are.  rgb48 pixels can't be looked up
+    lutEnabled = ccEnabled || (sizeof(RGB) <= 3 && this->layerBrightness < 255);
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]) {
+    fillRemappedRow(hardwareY, refreshRow);
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]) {
+    fillRemappedRow(hardwareY, refreshRow);
+}
+
+template <typename RGB, unsigned int optionFlags> template <typename RGB_OUT>
+void SMLayerRemap<RGB, optionFlags>::fillRemappedRow(uint16_t hardwareY, RGB_OUT refreshRow[]) {
+    const uint16_t * rowMap = &map[hardwareY * this->matrixWidth];
+    int i;
+
+    if(lutEnabled) {
+        for(i=this->refreshX0; i<=this->refreshX1; i++) {
+            if(rowMap[i] == SM_REMAP_BLANK)
+                continue;
+
+            // load pixel with color correction and brightness
+            const RGB & currentPixel = refreshBuffer[rowMap[i]];
+            refreshRow[i] = rgb48(colorCorrectionLUT[currentPixel.red], colorCorrectionLUT[currentPixel.green],
+                colorCorrectionLUT[currentPixel.blue]);
+        }
+    } else {
+        for(i=this->refreshX0; i<=this->refreshX1; i++) {
+            if(rowMap[i] == SM_REMAP_BLANK)
+                continue;
+
+            // load pixel without color correction
+            refreshRow[i] = refreshBuffer[rowMap[i]];
+        }
+    }
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::setMap(const uint16_t * map) {
+    pendingMap = map;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::enableColorCorrection(bool enabled) {
+    this->ccEnabled = sizeof(RGB) <= 3 ? enabled : false;
+    this->invalidate();
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::drawPixel(int16_t x, int16_t y, const RGB& color) {
+    if(x < 0 || y < 0 || x >= canvasWidth || y >= canvasHeight)
+        return;
+
+    drawBuffer[(y * canvasWidth) + x] = color;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::fillScreen(const RGB& color) {
+    int i;
+
+    for(i=0; i<REMAP_BUFFER_SIZE; i++)
+        drawBuffer[i] = color;
+}
+
+template <typename RGB, unsigned int optionFlags>
+const RGB SMLayerRemap<RGB, optionFlags>::readPixel(int16_t x, int16_t y) {
+    if(x < 0 || y < 0 || x >= canvasWidth || y >= canvasHeight)
+        return RGB(0, 0, 0);
+
+    return drawBuffer[(y * canvasWidth) + x];
+}
+
+template <typename RGB, unsigned int optionFlags>
+RGB * SMLayerRemap<RGB, optionFlags>::backBuffer(void) {
+    return drawBuffer;
+}
+
+template <typename RGB, unsigned int optionFlags>
+bool SMLayerRemap<RGB, optionFlags>::isSwapPending(void) {
+    return swapPending;
+}
+
+// waits until previous swap is complete
+// if copy is enabled, waits until this swap is complete and copies the new refresh buffer back to the drawing buffer
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::swapBuffers(bool copy) {
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    uint32_t swapRequestTime = SMFramePacing::swapRequested(this, swapPending);
+#endif
+    while (swapPending);
+
+    SM_TRACE(smTraceSwapRequested, smTraceLayerRemap, copy);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapQueued(this);
+#endif
+    swapPending = true;
+
+    if (copy) {
+        while (swapPending);
+        memcpy((void *)drawBuffer, (const void *)refreshBuffer, sizeof(RGB) * REMAP_BUFFER_SIZE);
+    }
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapReturned(this, swapRequestTime);
+#endif
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerRemap<RGB, optionFlags>::handleBufferSwap(void) {
+    if (!swapPending)
+        return;
+
+    RGB * newDrawBuffer = refreshBuffer;
+    refreshBuffer = drawBuffer;
+    drawBuffer = newDrawBuffer;
+
+    swapPending = false;
+    this->invalidate();
+    SM_TRACE(smTraceSwapComplete, smTraceLayerRemap, 0);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapPresented(this);
+#endif
+}
@@ -0,0 +1,118 @@
+/*
+ * SmartMatrix Library - Scaled Layer Class
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LAYER_SCALED_H_
+#define _LAYER_SCALED_H_
+
+#include "Layer.h"
+#include "MatrixCommon.h"
+#include "MatrixTrace.h"
+#include "MatrixFramePacing.h"
+
+#define SM_SCALED_OPTIONS_NONE      0
+
+// scale factors are fixed point, 8 fractional bits: SM_SCALED_LAYER_SCALE_ONE * 4 shows each source pixel as 4x4
+#define SM_SCALED_LAYER_SCALE_ONE   256
+
+// symmetry applied while refreshing, so only part of the screen has to be drawn
+typedef enum smMirrorMode {
+    smMirrorNone,
+    smMirrorHorizontal,     // the left half of the screen is reflected onto the right half
+    smMirrorVertical,       // the top half is reflected onto the bottom half
+    smMirrorQuad,           // the top left quarter is reflected into all four quarters
+    smMirrorKaleidoscope,   // 8-fold: the source pixels with x >= y fill the top left quarter, then it's reflected like smMirrorQuad
+} smMirrorMode;
+
+/*
+  A layer holding a small double buffered source image, scaled up with nearest neighbour sampling while refreshing.
+  Drawing is done in source pixels, in the coordinates of the rotated screen.  Every time the scale, position or
+  rotation changes, the layer works out which source pixel lands on each hardware column and row, so filling a row
+  is one table lookup per pixel.  Pixels outside the scaled image are transparent.
+
+  With a mirror mode, the screen is folded along its center lines before scaling, so the source only covers the half
+  or quarter of the screen that's drawn (a stretched source fills that part).  Kaleidoscope mode also folds along the
+  diagonal, it's meant for a square screen and a square source, and only the source pixels with x >= y are shown.
+ */
+template <typename RGB, unsigned int optionFlags>
+class SMLayerScaled : public SM_Layer {
+    public:
+        // buffer holds 2 * sourceWidth * sourceHeight pixels, indexTables holds width + height entries
+        SMLayerScaled(RGB * buffer, uint16_t sourceWidth, uint16_t sourceHeight, int32_t * indexTables, uint16_t width, uint16_t height);
+        void frameRefreshCallback();
+        void fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]);
+        void fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]);
+
+        void swapBuffers(bool copy = true);
+        bool isSwapPending(void);
+        void drawPixel(int16_t x, int16_t y, const RGB& color);
+        void fillScreen(const RGB& color);
+        // reads pixel from drawing buffer, not refresh buffer
+        const RGB readPixel(int16_t x, int16_t y);
+        // sourceWidth * sourceHeight pixels, row by row
+        RGB *backBuffer(void);
+
+        // scale factors in SM_SCALED_LAYER_SCALE_ONE units, 0 stretches the source to fill the screen in that direction
+        // the position is where the top left corner of the source goes on the screen, both take effect at the next frame
+        void setScale(uint16_t scaleX, uint16_t scaleY);
+        void setPosition(int16_t x, int16_t y);
+        // takes effect at the next frame
+        void setMirror(smMirrorMode mode);
+        void enableColorCorrection(bool enabled);
+
+    private:
+        template <typename RGB_OUT>
+        void fillScaledRow(uint16_t hardwareY, RGB_OUT refreshRow[]);
+        void calculateIndexTables(void);
+        int32_t sourceCoordinate(int localPosition, int position, uint16_t scale, uint16_t sourceSize, uint16_t localSize);
+        int32_t sourceX(int localX);
+        int32_t sourceY(int localY);
+        void handleBufferSwap(void);
+
+        bool ccEnabled = sizeof(RGB) <= 3 ? true : false;
+        // color correction and brightness, see frameRefreshCallback()
+        color_chan_t colorCorrectionLUT[256];
+        uint16_t colorCorrectionLUTKey = 0xFFFF;
+        bool lutEnabled = false;
+
+        uint16_t sourceWidth, sourceHeight;
+        RGB * drawBuffer;
+        RGB * refreshBuffer;
+        volatile bool swapPending = false;
+
+        // for each hardware column, the offset of its source pixel within a source row (or row offset after a 90/270
+        // rotation), and for each hardware row the offset of the start of its source row (or column), -1 if not covered
+        // in kaleidoscope mode both hold plain source coordinates, the larger one is x
+        int32_t * columnIndex;
+        int32_t * rowIndex;
+
+        uint16_t scaleX = 0, scaleY = 0;
+        int16_t positionX = 0, positionY = 0;
+        smMirrorMode mirrorMode = smMirrorNone;
+        smMirrorMode indexTablesMirrorMode = smMirrorNone;
+        volatile bool indexTablesChanged = true;
+        rotationDegrees indexTablesRotation;
+};
+
+#include "Layer_Scaled_Impl.h"
+
+#endif
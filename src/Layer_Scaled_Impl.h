@@ -0,0 +1,298 @@
+/*
+ * SmartMatrix Library - Scaled Layer Class
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#define SCALED_BUFFER_SIZE      (sourceWidth * sourceHeight)
+
+template <typename RGB, unsigned int optionFlags>
+SMLayerScaled<RGB, optionFlags>::SMLayerScaled(RGB * buffer, uint16_t sourceWidth, uint16_t sourceHeight, int32_t * indexTables, uint16_t width, uint16_t height) {
+    this->sourceWidth = sourceWidth;
+    this->sourceHeight = sourceHeight;
+    drawBuffer = &buffer[0];
+    refreshBuffer = &buffer[sourceWidth * sourceHeight];
+    columnIndex = &indexTables[0];
+    rowIndex = &indexTables[width];
+    this->matrixWidth = width;
+    this->matrixHeight = height;
+    indexTablesRotation = rotation0;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::frameRefreshCallback(void) {
+    handleBufferSwap();
+
+    if(indexTablesChanged || indexTablesRotation != this->rotation) {
+        indexTablesChanged = false;
+        calculateIndexTables();
+        this->invalidate();
+    }
+
+    updateLayerLUT(colorCorrectionLUT, colorCorrectionLUTKey, this->layerBrightness, ccEnabled);
+    // without color correction at full brightness, pixels are copied as they are.  rgb48 pixels can't be looked up
+    lutEnabled = ccEnabled || (sizeof(RGB) <= 3 && this->layerBrightness < 255);
+}
+
+// source pixel shown at a local screen coordinate, or -1 if it's outside the scaled image
+template <typename RGB, unsigned int optionFlags>
+int32_t SMLayerScaled<RGB, optionFlags>::sourceCoordinate(int localPosition, int position, uint16_t scale, uint16_t sourceSize, uint16_t localSize) {
+    int32_t offset = localPosition - position;
+    int32_t source;
+
+    if(offset < 0)
+        return -1;
+
+    if(scale)
+        source = (offset * SM_SCALED_LAYER_SCALE_ONE) / scale;
+    else
+        source = (offset * sourceSize) / localSize;
+
+    return (source < sourceSize) ? source : -1;
+}
+
+// mirrored axes are folded around the center of the screen first, the source covers the half that's left
+template <typename RGB, unsigned int optionFlags>
+int32_t SMLayerScaled<RGB, optionFlags>::sourceX(int localX) {
+    uint16_t size = this->localWidth;
+    uint16_t sourceSize = (indexTablesMirrorMode == smMirrorKaleidoscope && sourceHeight < sourceWidth) ? sourceHeight : sourceWidth;
+
+    if(indexTablesMirrorMode == smMirrorHorizontal || indexTablesMirrorMode == smMirrorQuad || indexTablesMirrorMode == smMirrorKaleidoscope) {
+        size = (size + 1) / 2;
+        if(localX >= size)
+            localX = (this->localWidth - 1) - localX;
+    }
+
+    return sourceCoordinate(localX, positionX, scaleX, sourceSize, size);
+}
+
+template <typename RGB, unsigned int optionFlags>
+int32_t SMLayerScaled<RGB, optionFlags>::sourceY(int localY) {
+    uint16_t size = this->localHeight;
+    uint16_t sourceSize = (indexTablesMirrorMode == smMirrorKaleidoscope && sourceWidth < sourceHeight) ? sourceWidth : sourceHeight;
+
+    if(indexTablesMirrorMode == smMirrorVertical || indexTablesMirrorMode == smMirrorQuad || indexTablesMirrorMode == smMirrorKaleidoscope) {
+        size = (size + 1) / 2;
+        if(localY >= size)
+            localY = (this->localHeight - 1) - localY;
+    }
+
+    return sourceCoordinate(localY, positionY, scaleY, sourceSize, size);
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::calculateIndexTables(void) {
+    int32_t source;
+    int i;
+
+    indexTablesRotation = this->rotation;
+    indexTablesMirrorMode = mirrorMode;
+
+    // kaleidoscope mode picks x and y per pixel, so y isn't turned into a row offset
+    int32_t rowStride = (indexTablesMirrorMode == smMirrorKaleidoscope) ? 1 : sourceWidth;
+
+    // hardware columns walk along a local row at rotation 0/180, and along a local column at 90/270
+    for(i=0; i<this->matrixWidth; i++) {
+        switch(this->rotation) {
+          case rotation180:
+            columnIndex[i] = sourceX((this->matrixWidth - 1) - i);
+            break;
+          case rotation90:
+            source = sourceY((this->matrixWidth - 1) - i);
+            columnIndex[i] = (source < 0) ? -1 : source * rowStride;
+            break;
+          case rotation270:
+            source = sourceY(i);
+            columnIndex[i] = (source < 0) ? -1 : source * rowStride;
+            break;
+          default:
+            columnIndex[i] = sourceX(i);
+            break;
+        }
+    }
+
+    for(i=0; i<this->matrixHeight; i++) {
+        switch(this->rotation) {
+          case rotation180:
+            source = sourceY((this->matrixHeight - 1) - i);
+            rowIndex[i] = (source < 0) ? -1 : source * rowStride;
+            break;
+          case rotation90:
+            rowIndex[i] = sourceX(i);
+            break;
+          case rotation270:
+            rowIndex[i] = sourceX((this->matrixHeight - 1) - i);
+            break;
+          default:
+            source = sourceY(i);
+            rowIndex[i] = (source < 0) ? -1 : source * rowStride;
+            break;
+        }
+    }
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]) {
+    fillScaledRow(hardwareY, refreshRow);
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb24 refreshRow[]) {
+    fillScaledRow(hardwareY, refreshRow);
+}
+
+// in kaleidoscope mode the pixel is reflected across the diagonal: the larger of the two coordinates is x
+#define SCALED_SOURCE_INDEX(column, row) \
+    (kaleidoscope ? ((column < row) ? column * sourceWidth + row : row * sourceWidth + column) : row + column)
+
+template <typename RGB, unsigned int optionFlags> template <typename RGB_OUT>
+void SMLayerScaled<RGB, optionFlags>::fillScaledRow(uint16_t hardwareY, RGB_OUT refreshRow[]) {
+    int32_t row = rowIndex[hardwareY];
+    bool kaleidoscope = (indexTablesMirrorMode == smMirrorKaleidoscope);
+    int i;
+
+    if(row < 0)
+        return;
+
+    if(lutEnabled) {
+        for(i=this->refreshX0; i<=this->refreshX1; i++) {
+            int32_t column = columnIndex[i];
+            if(column < 0)
+                continue;
+
+            // load pixel with color correction and brightness
+            const RGB & currentPixel = refreshBuffer[SCALED_SOURCE_INDEX(column, row)];
+            refreshRow[i] = rgb48(colorCorrectionLUT[currentPixel.red], colorCorrectionLUT[currentPixel.green],
+                colorCorrectionLUT[currentPixel.blue]);
+        }
+    } else {
+        for(i=this->refreshX0; i<=this->refreshX1; i++) {
+            int32_t column = columnIndex[i];
+            if(column < 0)
+                continue;
+
+            // load pixel without color correction
+            refreshRow[i] = refreshBuffer[SCALED_SOURCE_INDEX(column, row)];
+        }
+    }
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::setScale(uint16_t scaleX, uint16_t scaleY) {
+    this->scaleX = scaleX;
+    this->scaleY = scaleY;
+    indexTablesChanged = true;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::setPosition(int16_t x, int16_t y) {
+    positionX = x;
+    positionY = y;
+    indexTablesChanged = true;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::setMirror(smMirrorMode mode) {
+    mirrorMode = mode;
+    indexTablesChanged = true;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::enableColorCorrection(bool enabled) {
+    this->ccEnabled = sizeof(RGB) <= 3 ? enabled : false;
+    this->invalidate();
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::drawPixel(int16_t x, int16_t y, const RGB& color) {
+    if(x < 0 || y < 0 || x >= sourceWidth || y >= sourceHeight)
+        return;
+
+    drawBuffer[(y * sourceWidth) + x] = color;
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::fillScreen(const RGB& color) {
+    int i;
+
+    for(i=0; i<SCALED_BUFFER_SIZE; i++)
+        drawBuffer[i] = color;
+}
+
+template <typename RGB, unsigned int optionFlags>
+const RGB SMLayerScaled<RGB, optionFlags>::readPixel(int16_t x, int16_t y) {
+    if(x < 0 || y < 0 || x >= sourceWidth || y >= sourceHeight)
+        return RGB(0, 0, 0);
+
+    return drawBuffer[(y * sourceWidth) + x];
+}
+
+template <typename RGB, unsigned int optionFlags>
+RGB * SMLayerScaled<RGB, optionFlags>::backBuffer(void) {
+    return drawBuffer;
+}
+
+template <typename RGB, unsigned int optionFlags>
+bool SMLayerScaled<RGB, optionFlags>::isSwapPending(void) {
+    return swapPending;
+}
+
+// waits until previous swap is complete
+// if copy is enabled, waits until this swap is complete and copies the new refresh buffer back to the drawing buffer
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::swapBuffers(bool copy) {
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    uint32_t swapRequestTime = SMFramePacing::swapRequested(this, swapPending);
+#endif
+    while (swapPending);
+
+    SM_TRACE(smTraceSwapRequested, smTraceLayerScaled, copy);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapQueued(this);
+#endif
+    swapPending = true;
+
+    if (copy) {
+        while (swapPending);
+        memcpy((void *)drawBuffer, (const void *)refreshBuffer, sizeof(RGB) * SCALED_BUFFER_SIZE);
+    }
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapReturned(this, swapRequestTime);
+#endif
+}
+
+template <typename RGB, unsigned int optionFlags>
+void SMLayerScaled<RGB, optionFlags>::handleBufferSwap(void) {
+    if (!swapPending)
+        return;
+
+    RGB * newDrawBuffer = refreshBuffer;
+    refreshBuffer = drawBuffer;
+    drawBuffer = newDrawBuffer;
+
+    swapPending = false;
+    this->invalidate();
+    SM_TRACE(smTraceSwapComplete, smTraceLayerScaled, 0);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+    SMFramePacing::swapPresented(this);
+#endif
+}
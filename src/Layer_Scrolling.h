@@ -69,6 +69,9 @@ class SMLayerScrolling : public SM_Layer {
         void setStartOffsetFromLeft(int offset);
         void enableColorCorrection(bool enabled);
 
+    protected:
+        bool getContentBounds(int16_t & x0, int16_t & y0, int16_t & x1, int16_t & y1);
+
     private:
         void redrawScrollingText(void);
         void setMinMax(void);
@@ -115,15 +115,11 @@ bool SMLayerScrolling<RGB, optionFlags>::getPixel(uint16_t hardwareX, uint16_t h
 
 template <typename RGB, unsigned int optionFlags>
 void SMLayerScrolling<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb48 refreshRow[]) {
-    rgb48 currentPixel;
+    // once per row rather than per frame, so a row callback can change the color
+    rgb48 currentPixel = calculateLayerColor(textcolor, this->layerBrightness, ccEnabled);
     int i;
 
-    if(this->ccEnabled)
-        colorCorrection(textcolor, currentPixel);
-    else
-        currentPixel = textcolor;
-
-    for(i=0; i<this->matrixWidth; i++) {
+    for(i=this->refreshX0; i<=this->refreshX1; i++) {
         if(!getPixel(i, hardwareY))
             continue;
 
@@ -136,12 +132,9 @@ void SMLayerScrolling<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb2
     rgb24 currentPixel;
     int i;
 
-    if(this->ccEnabled)
-        colorCorrection(textcolor, currentPixel);
-    else
-        currentPixel = textcolor;
+    currentPixel = calculateLayerColor(textcolor, this->layerBrightness, ccEnabled);
 
-    for(i=0; i<this->matrixWidth; i++) {
+    for(i=this->refreshX0; i<=this->refreshX1; i++) {
         if(!getPixel(i, hardwareY))
             continue;
 
@@ -149,14 +142,29 @@ void SMLayerScrolling<RGB, optionFlags>::fillRefreshRow(uint16_t hardwareY, rgb2
     }
 }
 
+// only the text is drawn, so the refresh code can skip the rest of the screen
+template<typename RGB, unsigned int optionFlags>
+bool SMLayerScrolling<RGB, optionFlags>::getContentBounds(int16_t & x0, int16_t & y0, int16_t & x1, int16_t & y1) {
+    if(!textlen)
+        return false;
+
+    x0 = scrollPosition;
+    x1 = scrollPosition + (int)textWidth;
+    y0 = fontTopOffset;
+    y1 = fontTopOffset + scrollFont->Height - 1;
+    return true;
+}
+
 template<typename RGB, unsigned int optionFlags>
 void SMLayerScrolling<RGB, optionFlags>::setColor(const RGB & newColor) {
     textcolor = newColor;
+    this->invalidate();
 }
 
 template<typename RGB, unsigned int optionFlags>
 void SMLayerScrolling<RGB, optionFlags>::enableColorCorrection(bool enabled) {
     this->ccEnabled = sizeof(RGB) <= 3 ? enabled : false;
+    this->invalidate();
 }
 
 // stops the scrolling text on the next refresh
@@ -332,6 +340,7 @@ void SMLayerScrolling<RGB, optionFlags>::redrawScrollingText(void) {
     int j, k;
     int charPosition, textPosition;
     uint16_t charY0, charY1;
+    bool fullRedraw = majorScrollFontChange;
 
 
     for (j = 0; j < this->localHeight; j++) {
@@ -393,6 +402,12 @@ void SMLayerScrolling<RGB, optionFlags>::redrawScrollingText(void) {
 
         j += (charY1 - charY0) - 1;
     }
+
+    // only the text rows change unless the whole bitmap was cleared
+    if(fullRedraw)
+        this->invalidate();
+    else
+        this->markLocalRowsDirty(fontTopOffset, fontTopOffset + scrollFont->Height - 1);
 }
 
 template <typename RGB, unsigned int optionFlags>
@@ -0,0 +1,78 @@
+/*
+ * SmartMatrix Library - Affine Transforms for Sprites
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_AFFINE_H_
+#define _MATRIX_AFFINE_H_
+
+#include <stdint.h>
+#include <math.h>
+
+/*
+  A 2x3 matrix in 16.16 fixed point placing a bitmap on the screen, used by the background layer's
+  drawAffineBitmap() and drawAffineMonoBitmap():
+    screenX = a * sourceX + b * sourceY + tx
+    screenY = c * sourceX + d * sourceY + ty
+  Coordinates are at pixel edges: source pixel (0, 0) covers (0, 0) to (1, 1), so the identity with tx/ty of x/y
+  draws the bitmap at the same place as drawPixel(x + i, y + j) for each pixel.
+
+  The blit inverts the matrix once and steps through the source with additions for each destination pixel, only the
+  helpers below use floating point, and only once per sprite.
+ */
+
+#define SM_AFFINE_ONE                   0x10000
+
+// sample the nearest source pixel, or blend the four nearest for smoother edges and scaling
+#define SM_AFFINE_NEAREST               0
+#define SM_AFFINE_BILINEAR              (1 << 0)
+// rgb24 bitmaps: black source pixels aren't drawn (with SM_AFFINE_BILINEAR they're blended as transparent)
+#define SM_AFFINE_TRANSPARENT_BLACK     (1 << 1)
+
+typedef struct smAffineTransform {
+    int32_t a, b, tx;
+    int32_t c, d, ty;
+} smAffineTransform;
+
+static inline smAffineTransform smAffineTranslate(int16_t x, int16_t y) {
+    smAffineTransform transform = { SM_AFFINE_ONE, 0, (int32_t)x * SM_AFFINE_ONE, 0, SM_AFFINE_ONE, (int32_t)y * SM_AFFINE_ONE };
+    return transform;
+}
+
+// rotates by degrees clockwise (as seen on the screen) and scales around the point (sourceX, sourceY) in the bitmap,
+// and puts that point at (screenX, screenY), e.g. the center of a gauge needle's pivot and the center of the dial
+static inline smAffineTransform smAffineRotateScale(float degrees, float scale, float sourceX, float sourceY,
+    float screenX, float screenY) {
+    float radians = degrees * (float)M_PI / 180.0f;
+    float cosine = cosf(radians) * scale;
+    float sine = sinf(radians) * scale;
+    smAffineTransform transform;
+
+    transform.a = (int32_t)lroundf(cosine * SM_AFFINE_ONE);
+    transform.b = (int32_t)lroundf(-sine * SM_AFFINE_ONE);
+    transform.c = (int32_t)lroundf(sine * SM_AFFINE_ONE);
+    transform.d = (int32_t)lroundf(cosine * SM_AFFINE_ONE);
+    transform.tx = (int32_t)lroundf((screenX - cosine * sourceX + sine * sourceY) * SM_AFFINE_ONE);
+    transform.ty = (int32_t)lroundf((screenY - sine * sourceX - cosine * sourceY) * SM_AFFINE_ONE);
+    return transform;
+}
+
+#endif
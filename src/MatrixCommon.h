@@ -225,6 +225,71 @@ void colorCorrection(const RGB_IN& in, rgb24& out) {
 
 void calculateBackgroundLUT(color_chan_t * lut, uint8_t backgroundBrightness);
 
+// perceptual fades: lightPowerMap16bit maps evenly spaced perceived brightness to light output (out of 65535), these
+// convert between light output and a position along the table in 8.8 fixed point, interpolating between entries
+inline uint16_t smLuminanceToPerceptual(uint16_t luminance) {
+    int low = 0, high = 255;
+
+    // the last entry not above luminance, the table starts with repeated zeros
+    while(low < high) {
+        int middle = (low + high + 1) / 2;
+        if(lightPowerMap16bit[middle] <= luminance)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    if(low == 255)
+        return 255 << 8;
+    return (low << 8) + ((uint32_t)(luminance - lightPowerMap16bit[low]) << 8) / (lightPowerMap16bit[low + 1] - lightPowerMap16bit[low]);
+}
+
+inline uint16_t smPerceptualToLuminance(uint16_t position) {
+    int i = position >> 8;
+
+    if(i >= 255)
+        return lightPowerMap16bit[255];
+    return lightPowerMap16bit[i] + (((uint32_t)(lightPowerMap16bit[i + 1] - lightPowerMap16bit[i]) * (position & 0xFF)) >> 8);
+}
+
+// a layer's LUT for 8-bit channels with its brightness folded in, with or without color correction
+inline void calculateLayerLUT(color_chan_t * lut, uint8_t brightness, bool corrected) {
+    if(corrected) {
+        calculateBackgroundLUT(lut, brightness);
+        return;
+    }
+
+    for(int i=0; i<256; i++)
+        lut[i] = (Chan8ToColor(i) * brightness) / 256;
+}
+
+// rebuilds the LUT only if the brightness or color correction changed since the last call, key starts at 0xFFFF
+inline void updateLayerLUT(color_chan_t * lut, uint16_t & key, uint8_t brightness, bool corrected) {
+    uint16_t newKey = brightness | (corrected << 8);
+
+    if(newKey != key) {
+        calculateLayerLUT(lut, brightness, corrected);
+        key = newKey;
+    }
+}
+
+// the color a layer that draws in a single color shows, worked out once per frame instead of for each pixel
+template <typename RGB_IN>
+inline rgb48 calculateLayerColor(const RGB_IN& in, uint8_t brightness, bool corrected) {
+    rgb48 out;
+
+    if(corrected)
+        colorCorrection(in, out);
+    else
+        out = in;
+
+    // full brightness leaves the color as it is
+    if(brightness < 255)
+        out = rgb48((out.red * brightness) / 256, (out.green * brightness) / 256, (out.blue * brightness) / 256);
+
+    return out;
+}
+
 // config
 typedef enum rotationDegrees {
     rotation0,
@@ -0,0 +1,141 @@
+/*
+ * SmartMatrix Library - Static Refresh Cost Model
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_COST_MODEL_H_
+#define _MATRIX_COST_MODEL_H_
+
+#include <stdint.h>
+
+/*
+  Compile-time estimate of what a configuration costs to refresh, so walls that can't reach a target
+  refresh rate can be rejected at build time instead of finding out from getRefreshRateLoweredFlag().
+
+  Two limits are modeled:
+    - shifting: every latch of a row needs at least MIN_BLOCK_PERIOD_NS for DMA to clock out
+      PIXELS_PER_LATCH pixels, so a row can't be shorter than latchesPerRow blocks of that size (with
+      SMARTMATRIX_PARALLEL_CHAINS, each chain shifts its share of the row at the same time)
+    - CPU: rowCalculationISR() composites every layer and packs the row into the DMA buffer once per row,
+      and each layer gets a frameRefreshCallback() once per frame; that work has to fit in
+      SM_COSTMODEL_CPU_BUDGET_PERCENT of the CPU, leaving the rest for the sketch
+
+  The cycle counts below are estimates for a Teensy 3.x sketch compiled with the default (-O2) options.
+  They can be overridden before including SmartMatrix3.h with numbers measured for a specific build,
+  e.g. by timing rowCalculationISR() with DEBUG_PINS_ENABLED on an oscilloscope.
+ */
+
+// fixed cost of each row: ISR entry, updating matrixUpdateBlocks, clearing the temporary rows
+#ifndef SM_COSTMODEL_ROW_OVERHEAD_CYCLES
+#define SM_COSTMODEL_ROW_OVERHEAD_CYCLES            500
+#endif
+
+// cost of one layer's fillRefreshRow() per pixel
+#ifndef SM_COSTMODEL_LAYER_CYCLES_PER_PIXEL
+#define SM_COSTMODEL_LAYER_CYCLES_PER_PIXEL         20
+#endif
+
+// cost of packing one 32-bit word (four bitplanes) for a pair of pixels into the DMA buffer
+#ifndef SM_COSTMODEL_PACK_CYCLES_PER_WORD
+#define SM_COSTMODEL_PACK_CYCLES_PER_WORD           60
+#endif
+
+// cost of one layer's frameRefreshCallback() per frame (e.g. SMLayerBackground rebuilds its color correction LUT)
+#ifndef SM_COSTMODEL_LAYER_FRAME_CYCLES
+#define SM_COSTMODEL_LAYER_FRAME_CYCLES             3000
+#endif
+
+// share of the CPU the refresh code is allowed to use
+#ifndef SM_COSTMODEL_CPU_BUDGET_PERCENT
+#define SM_COSTMODEL_CPU_BUDGET_PERCENT             50
+#endif
+
+// FTM1 is clocked from F_BUS with a prescale of 1 (F_BUS/2), matching TIMER_FREQUENCY in MatrixDriver_Teensy3.h
+#ifndef SM_COSTMODEL_TIMER_FREQUENCY
+#define SM_COSTMODEL_TIMER_FREQUENCY                (F_BUS/2)
+#endif
+
+constexpr uint32_t smCostModelMin(uint32_t a, uint32_t b) {
+    return (a < b) ? a : b;
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+class SmartMatrix3CostModel {
+public:
+    static constexpr uint32_t latchesPerRow = refreshDepth/COLOR_CHANNELS_PER_PIXEL;
+    static constexpr uint32_t rowsPerFrame = CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(panelType);
+    static constexpr uint32_t pixelsPerRow = (matrixWidth * matrixHeight) / (2 * rowsPerFrame);
+    static constexpr uint32_t pixelsPerLatch = pixelsPerRow / SMARTMATRIX_PARALLEL_CHAINS;
+
+    // shifting limit, using the same MIN_BLOCK_PERIOD_NS calculation as the refresh code
+    static constexpr uint32_t minBlockPeriodNs = LATCH_TO_CLK_DELAY_NS + ((PANEL_32_PIXELDATA_TRANSFER_MAXIMUM_NS * pixelsPerLatch) / 32);
+    static constexpr uint32_t minBlockPeriodTicks = (uint32_t)(SM_COSTMODEL_TIMER_FREQUENCY * (minBlockPeriodNs / 1000000000.0));
+    static constexpr uint32_t minTicksPerRow = latchesPerRow * minBlockPeriodTicks;
+    static constexpr uint32_t maxRefreshRateShifting = SM_COSTMODEL_TIMER_FREQUENCY / (rowsPerFrame * minTicksPerRow);
+
+    // CPU limit - each row composites two rows of pixelsPerRow pixels (top and bottom half of the panels)
+    static constexpr uint32_t isrCyclesPerRow = SM_COSTMODEL_ROW_OVERHEAD_CYCLES +
+        (2 * pixelsPerRow * numLayers * SM_COSTMODEL_LAYER_CYCLES_PER_PIXEL) +
+        (pixelsPerRow * (latchesPerRow / sizeof(uint32_t)) * SM_COSTMODEL_PACK_CYCLES_PER_WORD);
+    static constexpr uint32_t cyclesPerFrame = (rowsPerFrame * isrCyclesPerRow) + (numLayers * SM_COSTMODEL_LAYER_FRAME_CYCLES);
+    static constexpr uint32_t maxRefreshRateCpu = (uint32_t)((((uint64_t)F_CPU * SM_COSTMODEL_CPU_BUDGET_PERCENT) / 100) / cyclesPerFrame);
+
+    // achievable refresh rate is the lower of the two limits
+    static constexpr uint32_t maxRefreshRate = smCostModelMin(maxRefreshRateShifting, maxRefreshRateCpu);
+
+    // estimated share of the CPU (in percent) spent refreshing at a given refresh rate
+    static constexpr uint32_t cpuPercentAtRefreshRate(uint32_t refreshRate) {
+        return (uint32_t)(((uint64_t)refreshRate * cyclesPerFrame * 100) / F_CPU);
+    }
+};
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::latchesPerRow;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::rowsPerFrame;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::pixelsPerRow;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::pixelsPerLatch;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::minBlockPeriodNs;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::minBlockPeriodTicks;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::minTicksPerRow;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::maxRefreshRateShifting;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::isrCyclesPerRow;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::cyclesPerFrame;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::maxRefreshRateCpu;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, int numLayers>
+constexpr uint32_t SmartMatrix3CostModel<refreshDepth, matrixWidth, matrixHeight, panelType, numLayers>::maxRefreshRate;
+
+// optional build-time check, e.g. after SMARTMATRIX_ALLOCATE_BUFFERS():
+// SMARTMATRIX_ASSERT_REFRESH_RATE(kMatrixWidth, kMatrixHeight, kRefreshDepth, kPanelType, 3, 120);
+#define SMARTMATRIX_ASSERT_REFRESH_RATE(width, height, pwm_depth, panel_type, num_layers, refresh_rate) \
+    static_assert(SmartMatrix3CostModel<pwm_depth, width, height, panel_type, num_layers>::maxRefreshRate >= (refresh_rate), \
+        "SmartMatrix configuration is estimated to be too slow for the target refresh rate")
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * SmartMatrix Library - Refresh Driver Interface
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_DRIVER_H_
+#define _MATRIX_DRIVER_H_
+
+#include <stdint.h>
+#include "MatrixPanels.h"
+
+/*
+  The refresh code is split in two:
+    - the core in SmartMatrix_Impl.h composites rows from the layers, packs them into the DMA buffer in the format
+      described by MatrixHardware_*.h, calculates the timer LUT, and keeps the buffer full
+    - a driver outputs the packed rows and calls the core's ISRs, it doesn't know about layers or pixel formats
+
+  A driver is a class with these static functions, selected with the SMDriver typedef in SmartMatrix3.h:
+    begin(config)               set up the hardware and start refreshing from config->firstBlocks/firstData
+    loadNextRow(blocks, data)   called from rowShiftCompleteISR: the row to output after the current one
+    loadIdleRow(idle)           called from rowShiftCompleteISR when the buffer is empty: keep repeating the idle timer
+                                values with the display off, and stop calling rowShiftCompleteISR
+    restartRow(blocks, data)    called from rowCalculationISR once rows are ready again after loadIdleRow()
+    rowShiftCompleteDone()      called at the end of rowShiftCompleteISR: trigger rowCalculationISR (at a lower priority)
+    disableRowCalculation()     keep rowCalculationISR from running, used around code that shares its state
+    enableRowCalculation()
+  and defines TIMER_FREQUENCY, the rate of the ticks in the timer LUT, and TIMER_PERIOD_EXTRA_TICKS, the ticks a block
+  takes beyond its timer_period (e.g. 1 for a timer that counts from 0 up to and including the period).
+
+  Each row output is latchesPerRow blocks: for block i, DMA_UPDATES_PER_CLOCK * pixels + ADDX_UPDATE_BEFORE_LATCH_BYTES
+  bytes are written to the data pins, reading every latchesPerRow bytes starting at data + i, then the data is latched
+  and the display is enabled using blocks[i].timerValues.  With parallelChains > 1 each of those transfers is
+  parallelChains bytes wide (chain n's byte at offset n), starting at data + i * parallelChains.
+ */
+
+#define INLINE __attribute__( ( always_inline ) ) inline
+
+typedef struct timerpair {
+    uint16_t timer_oe;
+    uint16_t timer_period;
+} timerpair;
+
+typedef struct addresspair {
+    uint16_t bits_to_clear;
+    uint16_t bits_to_set;
+} addresspair;
+
+typedef struct matrixUpdateBlock {
+    timerpair timerValues;
+    addresspair addressValues;
+} matrixUpdateBlock;
+
+typedef struct smDriverConfig {
+    const matrixUpdateBlock * firstBlocks;  // first row in the DMA buffer
+    const uint8_t * firstData;
+    uint8_t latchesPerRow;
+    uint16_t bytesPerLatch;                 // bytes written to the data pins for each block, per chain
+    uint8_t parallelChains;                 // each DMA transfer writes parallelChains consecutive bytes, one per chain
+    uint16_t initialPeriod;                 // timer period until the first row is loaded
+    uint16_t latchPulseTicks;               // dead time at the start of each block while the latch is high
+    void (*rowShiftCompleteISR)(void);
+    void (*rowCalculationISR)(void);
+
+    // panel layout, only needed by drivers that decode the output
+    uint16_t matrixWidth;
+    uint16_t matrixHeight;
+    uint16_t panelHeight;
+    uint16_t rowPairOffset;
+    uint16_t rowsPerFrame;
+    smPanelDescription panel;               // order pixels are shifted, see MatrixPanels.h
+    uint8_t optionFlags;
+} smDriverConfig;
+
+#endif
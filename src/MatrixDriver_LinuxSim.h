@@ -0,0 +1,418 @@
+/*
+ * SmartMatrix Library - Linux Simulator Refresh Driver
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_DRIVER_LINUXSIM_H_
+#define _MATRIX_DRIVER_LINUXSIM_H_
+
+#include <thread>
+#include <chrono>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "MatrixPreview.h"
+
+/*
+  Runs the refresh code on Linux without a panel, to try sketches and test the library on a PC.  Used automatically
+  when building for Linux without ARDUINO defined (or with SMARTMATRIX_LINUX_SIM defined), with
+  MatrixHardware_LinuxSim.h standing in for Arduino.h.  The sketch supplies main(), calling setup() and loop().
+
+  A thread stands in for the Teensy's DMA and timer: it takes each row the refresh code packed into the DMA buffer,
+  decodes the bitplanes using the on-time of each block from the timer LUT, and writes the result into a framebuffer,
+  then calls rowShiftCompleteISR and rowCalculationISR like the hardware would.  The framebuffer is in hardware
+  coordinates (after the layers' rotation is applied), undoing the panel stacking options, with each channel scaled to
+  0-255 at full brightness.
+
+  By default the thread sleeps for the time each row would take on the panel, so refresh rate and timing behave like
+  the hardware.  setRealtime(false) runs rows back to back as fast as possible.
+
+  After matrix.begin(), beginPreview() also publishes each frame refreshed to POSIX shared memory, in the format
+  described in MatrixPreview.h, for a viewer (extras/tools/smpreview.py) or test in another process.  With realtime
+  off, the frame timestamps measure the throughput of the whole refresh pipeline.
+ */
+
+// timer ticks are simulated at the same rate as FTM1 on Teensy, which counts from 0 to the period inclusive
+#define TIMER_FREQUENCY     (F_BUS/2)
+#define TIMER_PERIOD_EXTRA_TICKS    1
+
+class SMDriverLinuxSim {
+    public:
+        static void begin(const smDriverConfig * config);
+        static void end(void);
+        static void setRealtime(bool enabled);
+
+        // copies the framebuffer, matrixWidth * matrixHeight pixels
+        static void getFramebuffer(rgb24 * buffer);
+        static uint32_t getRowsRefreshed(void);
+        static uint32_t getFramesRefreshed(void);
+        // refresh rate measured in simulated timer ticks, between the end of the first frame and the latest one
+        static double getMeasuredRefreshRate(void);
+
+        // shared memory preview, call after matrix.begin(), returns false if the shared memory can't be created
+        static bool beginPreview(const char * name = SM_PREVIEW_DEFAULT_NAME);
+        static void endPreview(void);
+
+        // driver interface, see MatrixDriver.h
+        static INLINE void loadNextRow(const matrixUpdateBlock * blocks, const uint8_t * data);
+        static INLINE void loadIdleRow(const timerpair * idle);
+        static INLINE void restartRow(const matrixUpdateBlock * blocks, const uint8_t * data);
+        static INLINE void rowShiftCompleteDone(void);
+        static INLINE void disableRowCalculation(void);
+        static INLINE void enableRowCalculation(void);
+
+    private:
+        static void refreshLoop(void);
+        static uint32_t refreshRow(void);
+        static uint16_t decodeRow(const matrixUpdateBlock * blocks, const uint8_t * data);
+        static void publishPreview(void);
+        static uint16_t hardwareY(uint16_t address, uint8_t half, uint16_t section, uint8_t subRow);
+
+        static smDriverConfig config;
+        static std::thread refreshThread;
+        static volatile bool running;
+        static volatile bool realtime;
+        static const matrixUpdateBlock * nextBlocks;
+        static const uint8_t * nextData;
+        static const timerpair * idleTimer;     // not NULL while idle
+        static bool rowCalculationPending;
+        static rgb24 * framebuffer;
+        static volatile uint32_t rowsRefreshed;
+        static volatile uint32_t framesRefreshed;
+        static uint64_t ticksRefreshed;
+        static uint64_t firstFrameTicks;
+        static uint64_t lastFrameTicks;
+        static smPreviewHeader * preview;
+        static size_t previewSize;
+        static char previewName[64];
+};
+
+inline void SMDriverLinuxSim::begin(const smDriverConfig * newConfig) {
+    config = *newConfig;
+    nextBlocks = config.firstBlocks;
+    nextData = config.firstData;
+    idleTimer = NULL;
+    rowCalculationPending = false;
+    rowsRefreshed = 0;
+    framesRefreshed = 0;
+    ticksRefreshed = 0;
+
+    delete[] framebuffer;
+    framebuffer = new rgb24[config.matrixWidth * config.matrixHeight];
+
+    running = true;
+    refreshThread = std::thread(refreshLoop);
+
+    // a std::thread still running when it's destroyed calls terminate(), so stop it if the sketch returns from main()
+    // without calling end()
+    static bool exitHandlerAdded = false;
+    if(!exitHandlerAdded) {
+        atexit(end);
+        exitHandlerAdded = true;
+    }
+}
+
+inline void SMDriverLinuxSim::end(void) {
+    if(!running)
+        return;
+
+    running = false;
+    refreshThread.join();
+
+    endPreview();
+}
+
+inline void SMDriverLinuxSim::setRealtime(bool enabled) {
+    realtime = enabled;
+}
+
+inline void SMDriverLinuxSim::getFramebuffer(rgb24 * buffer) {
+    int i;
+
+    noInterrupts();
+    for(i=0; i<config.matrixWidth * config.matrixHeight; i++)
+        buffer[i] = framebuffer[i];
+    interrupts();
+}
+
+inline uint32_t SMDriverLinuxSim::getRowsRefreshed(void) {
+    return rowsRefreshed;
+}
+
+inline uint32_t SMDriverLinuxSim::getFramesRefreshed(void) {
+    return framesRefreshed;
+}
+
+inline double SMDriverLinuxSim::getMeasuredRefreshRate(void) {
+    double rate = 0;
+
+    noInterrupts();
+    if(framesRefreshed > 1)
+        rate = ((double)(framesRefreshed - 1) * TIMER_FREQUENCY) / (lastFrameTicks - firstFrameTicks);
+    interrupts();
+
+    return rate;
+}
+
+inline bool SMDriverLinuxSim::beginPreview(const char * name) {
+    uint32_t slotSize = (sizeof(smPreviewSlot) + 3 * config.matrixWidth * config.matrixHeight + 7) & ~7;
+    size_t size = sizeof(smPreviewHeader) + SMARTMATRIX_PREVIEW_SLOTS * slotSize;
+
+    endPreview();
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if(fd < 0)
+        return false;
+
+    if(ftruncate(fd, size) < 0) {
+        close(fd);
+        return false;
+    }
+
+    void * memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED)
+        return false;
+
+    smPreviewHeader * header = (smPreviewHeader *)memory;
+    memset(memory, 0x00, size);
+    header->version = SM_PREVIEW_VERSION;
+    header->headerSize = sizeof(smPreviewHeader);
+    header->width = config.matrixWidth;
+    header->height = config.matrixHeight;
+    header->slotCount = SMARTMATRIX_PREVIEW_SLOTS;
+    header->slotSize = slotSize;
+    // write the magic last so a viewer doesn't use a half written header
+    __sync_synchronize();
+    header->magic = SM_PREVIEW_MAGIC;
+
+    noInterrupts();
+    strncpy(previewName, name, sizeof(previewName) - 1);
+    previewSize = size;
+    preview = header;
+    interrupts();
+    return true;
+}
+
+inline void SMDriverLinuxSim::endPreview(void) {
+    if(!preview)
+        return;
+
+    noInterrupts();
+    smPreviewHeader * header = preview;
+    preview = NULL;
+    interrupts();
+
+    // viewers that already have it mapped can keep reading the last frames
+    munmap(header, previewSize);
+    shm_unlink(previewName);
+}
+
+// copies the framebuffer into the next slot, called after the last row of a frame is refreshed
+inline void SMDriverLinuxSim::publishPreview(void) {
+    smPreviewSlot * slot = (smPreviewSlot *)((uint8_t *)preview + preview->headerSize + ((framesRefreshed - 1) % preview->slotCount) * preview->slotSize);
+    uint8_t * pixels = (uint8_t *)(slot + 1);
+    int i;
+
+    slot->sequence++;
+    __sync_synchronize();
+
+    slot->frame = framesRefreshed;
+    slot->timestamp = smSimNanoseconds();
+    slot->rowsRefreshed = rowsRefreshed;
+    for(i=0; i<config.matrixWidth * config.matrixHeight; i++) {
+        *pixels++ = framebuffer[i].red;
+        *pixels++ = framebuffer[i].green;
+        *pixels++ = framebuffer[i].blue;
+    }
+
+    __sync_synchronize();
+    slot->sequence++;
+    __sync_synchronize();
+    preview->latestFrame = framesRefreshed;
+}
+
+INLINE void SMDriverLinuxSim::loadNextRow(const matrixUpdateBlock * blocks, const uint8_t * data) {
+    nextBlocks = blocks;
+    nextData = data;
+}
+
+INLINE void SMDriverLinuxSim::loadIdleRow(const timerpair * idle) {
+    idleTimer = idle;
+}
+
+INLINE void SMDriverLinuxSim::restartRow(const matrixUpdateBlock * blocks, const uint8_t * data) {
+    loadNextRow(blocks, data);
+    idleTimer = NULL;
+}
+
+INLINE void SMDriverLinuxSim::rowShiftCompleteDone(void) {
+    rowCalculationPending = true;
+}
+
+// the refresh thread can't be interrupted, so this holds off both "ISRs"
+INLINE void SMDriverLinuxSim::disableRowCalculation(void) {
+    noInterrupts();
+}
+
+INLINE void SMDriverLinuxSim::enableRowCalculation(void) {
+    interrupts();
+}
+
+inline void SMDriverLinuxSim::refreshLoop(void) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+
+    while(running) {
+        uint32_t ticks = refreshRow();
+
+        if(realtime) {
+            deadline += std::chrono::nanoseconds(((uint64_t)ticks * 1000000000ULL) / TIMER_FREQUENCY);
+            std::this_thread::sleep_until(deadline);
+        } else {
+            deadline = std::chrono::steady_clock::now();
+            std::this_thread::yield();
+        }
+    }
+}
+
+// output one row (or one idle period), returns the number of timer ticks it takes on the hardware
+inline uint32_t SMDriverLinuxSim::refreshRow(void) {
+    uint32_t ticks = 0;
+    int i;
+
+    noInterrupts();
+
+    if(idleTimer) {
+        ticks = idleTimer->timer_period + TIMER_PERIOD_EXTRA_TICKS;
+        ticksRefreshed += ticks;
+    } else {
+        uint16_t address = decodeRow(nextBlocks, nextData);
+        for(i=0; i<config.latchesPerRow; i++)
+            ticks += nextBlocks[i].timerValues.timer_period + TIMER_PERIOD_EXTRA_TICKS;
+        ticksRefreshed += ticks;
+        rowsRefreshed++;
+
+        if(address == config.rowsPerFrame - 1) {
+            if(!framesRefreshed)
+                firstFrameTicks = ticksRefreshed;
+            lastFrameTicks = ticksRefreshed;
+            framesRefreshed++;
+            if(preview)
+                publishPreview();
+        }
+
+        config.rowShiftCompleteISR();
+    }
+
+    if(rowCalculationPending) {
+        rowCalculationPending = false;
+        config.rowCalculationISR();
+    }
+
+    interrupts();
+    return ticks;
+}
+
+// inverse of the stacking in SmartMatrix3::fillRowFromLayers(): the hardware row shown by half of a section of the row,
+// sections are numbered across all chains, and subRow is which of the rows lit by the address in that half
+inline uint16_t SMDriverLinuxSim::hardwareY(uint16_t address, uint8_t half, uint16_t section, uint8_t subRow) {
+    uint16_t stackHeight = config.matrixHeight / (config.panelHeight * config.parallelChains);
+    uint16_t rowsPerAddress = config.panelHeight / (2 * config.rowsPerFrame);
+    uint16_t chainY = (section / stackHeight) * stackHeight * config.panelHeight;
+    uint16_t flippedAddress = config.rowsPerFrame - address - 1 + (rowsPerAddress - subRow - 1) * config.rowsPerFrame;
+    bool cShape = config.optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING;
+    bool bottomToTop = config.optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING;
+
+    address += subRow * config.rowsPerFrame;
+    section %= stackHeight;
+
+    if(!cShape && bottomToTop)
+        return chainY + address + (half ? config.rowPairOffset : 0) + (stackHeight - section - 1) * config.panelHeight;
+
+    if(!cShape)
+        return chainY + address + (half ? config.rowPairOffset : 0) + section * config.panelHeight;
+
+    if(bottomToTop) {
+        if((stackHeight - section + 1) % 2)
+            return chainY + flippedAddress + (half ? 0 : config.rowPairOffset) + section * config.panelHeight;
+        return chainY + address + (half ? config.rowPairOffset : 0) + section * config.panelHeight;
+    }
+
+    if((stackHeight - section) % 2)
+        return chainY + address + (half ? config.rowPairOffset : 0) + (stackHeight - section - 1) * config.panelHeight;
+    return chainY + flippedAddress + (half ? 0 : config.rowPairOffset) + (stackHeight - section - 1) * config.panelHeight;
+}
+
+// returns the row address
+inline uint16_t SMDriverLinuxSim::decodeRow(const matrixUpdateBlock * blocks, const uint8_t * data) {
+    uint16_t pixelsPerLatch = (config.bytesPerLatch - ADDX_UPDATE_BEFORE_LATCH_BYTES) / DMA_UPDATES_PER_CLOCK;
+    uint16_t sectionPixels = config.matrixWidth * (config.panelHeight / (2 * config.rowsPerFrame));
+    uint8_t chains = config.parallelChains;
+    uint16_t address = data[pixelsPerLatch * DMA_UPDATES_PER_CLOCK * config.latchesPerRow * chains] & SM_SIM_ADDRESS_MASK;
+    uint32_t onTime[32];
+    uint32_t fullScale = 0;
+    int i, j;
+
+    // the LED is on from the OE compare to the end of the period, at full brightness the MSB is on for the whole period
+    // apart from the latch pulse, and each lower bit for half as long as the next
+    uint32_t msbTicks = blocks[config.latchesPerRow - 1].timerValues.timer_period - config.latchPulseTicks;
+    for(i=0; i<config.latchesPerRow; i++) {
+        onTime[i] = blocks[i].timerValues.timer_period - blocks[i].timerValues.timer_oe;
+        fullScale += msbTicks >> (config.latchesPerRow - i - 1);
+    }
+
+    // pixels are numbered across all chains, chain n's pixels start at n * pixelsPerLatch
+    for(i=0; i<pixelsPerLatch * chains; i++) {
+        uint32_t r1 = 0, g1 = 0, b1 = 0, r2 = 0, g2 = 0, b2 = 0;
+        uint16_t section = i / sectionPixels;
+        uint16_t chain = i / pixelsPerLatch;
+        uint16_t pixel = i % pixelsPerLatch;
+        uint8_t subRow;
+        uint16_t x = smPanelPixelPosition(config.panel, config.matrixWidth, i % sectionPixels, &subRow);
+
+        // bitplanes are stored LSB first, with the clock low byte for each pixel before the clock high byte, and each
+        // transfer holds a byte for every chain
+        for(j=0; j<config.latchesPerRow; j++) {
+            uint8_t bits = data[(pixel * DMA_UPDATES_PER_CLOCK * config.latchesPerRow + j) * chains + chain];
+            if(bits & SM_SIM_BIT_R1) r1 += onTime[j];
+            if(bits & SM_SIM_BIT_G1) g1 += onTime[j];
+            if(bits & SM_SIM_BIT_B1) b1 += onTime[j];
+            if(bits & SM_SIM_BIT_R2) r2 += onTime[j];
+            if(bits & SM_SIM_BIT_G2) g2 += onTime[j];
+            if(bits & SM_SIM_BIT_B2) b2 += onTime[j];
+        }
+
+        // C-shape stacking shifts out every other section backwards
+        if((config.optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && !((pixel / sectionPixels) % 2))
+            x = config.matrixWidth - x - 1;
+
+        rgb24 * top = &framebuffer[hardwareY(address, 0, section, subRow) * config.matrixWidth + x];
+        rgb24 * bottom = &framebuffer[hardwareY(address, 1, section, subRow) * config.matrixWidth + x];
+        *top = rgb24((r1 * 255 + fullScale/2) / fullScale, (g1 * 255 + fullScale/2) / fullScale, (b1 * 255 + fullScale/2) / fullScale);
+        *bottom = rgb24((r2 * 255 + fullScale/2) / fullScale, (g2 * 255 + fullScale/2) / fullScale, (b2 * 255 + fullScale/2) / fullScale);
+    }
+
+    return address;
+}
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * SmartMatrix Library - Blur, Fade and Glow Filters
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_FILTERS_H_
+#define _MATRIX_FILTERS_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "MatrixCommon.h"
+
+/*
+  In-place filters for effects like trails, glow and bloom, on width x height rgb24 or rgb48 buffers such as the
+  background layer's backBuffer().  scale and strength are 0-256, where 256 is full strength:
+    smFilterFade(buffer, width, height, scale)          buffer = buffer * scale / 256, e.g. 240 for slowly fading trails
+    smFilterAdd(buffer, source, width, height, scale)   buffer += source * scale / 256, saturating, 256 adds all of source
+    smFilterBoxBlur(buffer, width, height, radius)      each pixel becomes the average of the square 2*radius+1 pixels
+                                                        wide around it, edge pixels are repeated beyond the edges
+    smFilterGaussianBlur(buffer, width, height, radius) three box blurs, close to a Gaussian blur with a standard
+                                                        deviation of about radius
+    smFilterGlow(buffer, scratch, width, height, radius, strength)
+                                                        adds a blurred copy of the buffer made in scratch (a second
+                                                        buffer the same size) back on top, scaled by strength / 256
+
+  The blurs are separable, a pass along the rows then a pass down the columns, and keep a running sum of the window, so
+  they cost the same per pixel whatever the radius.  The passes only need a copy of the last radius + 1 pixels, which is
+  why the radius is limited to SMARTMATRIX_FILTER_MAX_RADIUS.  Fading and adding rgb24 buffers work on four channels at
+  a time in 32-bit words (two 16-bit lanes of two channels each, in plain C), so they don't depend on the CPU having
+  SIMD instructions.
+
+  The filters don't know about rotation, which doesn't matter as they treat rows and columns the same.
+ */
+
+#ifndef SMARTMATRIX_FILTER_MAX_RADIUS
+#define SMARTMATRIX_FILTER_MAX_RADIUS   16
+#endif
+
+// scale two channels in the 16-bit lanes of a word (the low byte of each lane) by scale/256, scale is 0-256
+static inline uint32_t smFilterScaleLanes(uint32_t lanes, uint16_t scale) {
+    return ((lanes * scale) >> 8) & 0x00FF00FF;
+}
+
+// scale four 8-bit channels packed in a word
+static inline uint32_t smFilterScaleWord(uint32_t word, uint16_t scale) {
+    return smFilterScaleLanes(word & 0x00FF00FF, scale) | (smFilterScaleLanes((word >> 8) & 0x00FF00FF, scale) << 8);
+}
+
+// add two channels in 16-bit lanes, setting any lane that overflows 8 bits to 255
+static inline uint32_t smFilterAddLanes(uint32_t a, uint32_t b) {
+    uint32_t sum = a + b;
+    uint32_t overflow = sum & 0x01000100;
+    return (sum | (overflow - (overflow >> 8))) & 0x00FF00FF;
+}
+
+static inline uint32_t smFilterAddWord(uint32_t a, uint32_t b) {
+    return smFilterAddLanes(a & 0x00FF00FF, b & 0x00FF00FF) | (smFilterAddLanes((a >> 8) & 0x00FF00FF, (b >> 8) & 0x00FF00FF) << 8);
+}
+
+// rgb48 (and any other RGB type) one channel at a time
+template <typename RGB>
+void smFilterFade(RGB * buffer, uint16_t width, uint16_t height, uint16_t scale) {
+    uint32_t count = (uint32_t)width * height;
+
+    for(uint32_t i = 0; i < count; i++) {
+        buffer[i].red = (buffer[i].red * scale) >> 8;
+        buffer[i].green = (buffer[i].green * scale) >> 8;
+        buffer[i].blue = (buffer[i].blue * scale) >> 8;
+    }
+}
+
+template <typename RGB>
+void smFilterAdd(RGB * buffer, const RGB * source, uint16_t width, uint16_t height, uint16_t scale) {
+    uint32_t count = (uint32_t)width * height;
+    const uint32_t maximum = (1UL << (8 * sizeof(buffer[0].red))) - 1;
+
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t red = buffer[i].red + ((source[i].red * (uint32_t)scale) >> 8);
+        uint32_t green = buffer[i].green + ((source[i].green * (uint32_t)scale) >> 8);
+        uint32_t blue = buffer[i].blue + ((source[i].blue * (uint32_t)scale) >> 8);
+        buffer[i].red = red > maximum ? maximum : red;
+        buffer[i].green = green > maximum ? maximum : green;
+        buffer[i].blue = blue > maximum ? maximum : blue;
+    }
+}
+
+// rgb24 buffers are a plain run of bytes, so go through them a word at a time, whatever the alignment
+inline void smFilterFade(rgb24 * buffer, uint16_t width, uint16_t height, uint16_t scale) {
+    uint8_t * bytes = (uint8_t *)buffer;
+    uint32_t count = (uint32_t)width * height * sizeof(rgb24);
+    uint32_t i = 0;
+
+    for(; i + sizeof(uint32_t) <= count; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        word = smFilterScaleWord(word, scale);
+        memcpy(bytes + i, &word, sizeof(word));
+    }
+    for(; i < count; i++)
+        bytes[i] = (bytes[i] * scale) >> 8;
+}
+
+inline void smFilterAdd(rgb24 * buffer, const rgb24 * source, uint16_t width, uint16_t height, uint16_t scale) {
+    uint8_t * bytes = (uint8_t *)buffer;
+    const uint8_t * sourceBytes = (const uint8_t *)source;
+    uint32_t count = (uint32_t)width * height * sizeof(rgb24);
+    uint32_t i = 0;
+
+    for(; i + sizeof(uint32_t) <= count; i += sizeof(uint32_t)) {
+        uint32_t word, sourceWord;
+        memcpy(&word, bytes + i, sizeof(word));
+        memcpy(&sourceWord, sourceBytes + i, sizeof(sourceWord));
+        word = smFilterAddWord(word, smFilterScaleWord(sourceWord, scale));
+        memcpy(bytes + i, &word, sizeof(word));
+    }
+    for(; i < count; i++) {
+        uint16_t sum = bytes[i] + ((sourceBytes[i] * scale) >> 8);
+        bytes[i] = sum > 255 ? 255 : sum;
+    }
+}
+
+// one pass of the box blur over count pixels, stride pixels apart, using a running sum of the window: each step adds
+// the pixel entering the window and subtracts the one leaving it.  Pixels are overwritten as the window passes, so
+// the original values still in the window are kept in a ring of radius + 1 pixels
+template <typename RGB>
+void smFilterBoxBlurLine(RGB * pixels, uint16_t count, uint16_t stride, uint8_t radius) {
+    RGB history[SMARTMATRIX_FILTER_MAX_RADIUS + 1];
+    const uint32_t window = 2 * radius + 1;
+    // sum * reciprocal >> 32 divides by window without a divide, exact while sum * window stays under 2^32, which holds
+    // for rgb48 up to a radius of over 100
+    const uint32_t reciprocal = (uint32_t)(0x100000000ULL / window) + 1;
+    const RGB first = pixels[0];
+    const int last = count - 1;
+    uint32_t red, green, blue;
+    int x, historyIndex = 0;
+
+    // window around pixel 0, with pixel 0 repeated before the start
+    red = first.red * (radius + 1);
+    green = first.green * (radius + 1);
+    blue = first.blue * (radius + 1);
+    for(x = 1; x <= radius; x++) {
+        const RGB & pixel = pixels[(x < last ? x : last) * stride];
+        red += pixel.red;
+        green += pixel.green;
+        blue += pixel.blue;
+    }
+
+    for(x = 0; x < count; x++) {
+        RGB & pixel = pixels[x * stride];
+        history[historyIndex] = pixel;
+        if(++historyIndex > radius)
+            historyIndex = 0;
+
+        pixel.red = ((uint64_t)(red + window / 2) * reciprocal) >> 32;
+        pixel.green = ((uint64_t)(green + window / 2) * reciprocal) >> 32;
+        pixel.blue = ((uint64_t)(blue + window / 2) * reciprocal) >> 32;
+
+        // slide the window: x + radius + 1 hasn't been overwritten yet, x - radius is the oldest pixel in the ring
+        const RGB & entering = pixels[(x + radius + 1 < last ? x + radius + 1 : last) * stride];
+        const RGB & leaving = (x - radius > 0) ? history[historyIndex] : first;
+        red += entering.red - leaving.red;
+        green += entering.green - leaving.green;
+        blue += entering.blue - leaving.blue;
+    }
+}
+
+template <typename RGB>
+void smFilterBoxBlur(RGB * buffer, uint16_t width, uint16_t height, uint8_t radius) {
+    int i;
+
+    if(radius > SMARTMATRIX_FILTER_MAX_RADIUS)
+        radius = SMARTMATRIX_FILTER_MAX_RADIUS;
+    if(!radius)
+        return;
+
+    for(i = 0; i < height; i++)
+        smFilterBoxBlurLine(buffer + i * width, width, 1, radius);
+    for(i = 0; i < width; i++)
+        smFilterBoxBlurLine(buffer + i, height, width, radius);
+}
+
+template <typename RGB>
+void smFilterGaussianBlur(RGB * buffer, uint16_t width, uint16_t height, uint8_t radius) {
+    // three passes of a box blur 2r+1 wide have a variance of r(r+1), close to a Gaussian with a standard deviation of r
+    smFilterBoxBlur(buffer, width, height, radius);
+    smFilterBoxBlur(buffer, width, height, radius);
+    smFilterBoxBlur(buffer, width, height, radius);
+}
+
+template <typename RGB>
+void smFilterGlow(RGB * buffer, RGB * scratch, uint16_t width, uint16_t height, uint8_t radius, uint16_t strength) {
+    memcpy((void *)scratch, (const void *)buffer, sizeof(RGB) * width * height);
+    smFilterGaussianBlur(scratch, width, height, radius);
+    smFilterAdd(buffer, scratch, width, height, strength);
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * SmartMatrix Library - Frame Pacing Statistics
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_FRAME_PACING_H_
+#define _MATRIX_FRAME_PACING_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+  Frame pacing statistics measured at the swap, so they show what reaches the panel instead of how often
+  loop() runs.  To collect statistics, add this line before including SmartMatrix3.h:
+    #define SMARTMATRIX_FRAME_PACING_ENABLED
+
+  Measured for each swapBuffers() call on the background and indexed layers:
+    - frame interval: time between the sketch's calls to swapBuffers()
+    - swap wait: time swapBuffers() blocked waiting for the previous swap (and the copy, if enabled)
+    - present latency: time from the swap being queued until the refresh code started displaying it
+    - present interval: time between new frames starting to be displayed
+  Frames dropped counts swaps requested while the previous swap hadn't been displayed yet.  swapBuffers()
+  blocks instead of replacing the pending frame, so each of these costs the sketch a wait (see swap wait).
+
+  The last SMARTMATRIX_FRAME_PACING_SAMPLES samples of each are kept, and SMFramePacing::getStats() sorts a copy
+  to get percentiles, call it from loop() and not too often.  If more than one layer is swapped each frame, use
+  SMFramePacing::trackLayer() to choose which one to measure, otherwise all swaps are counted together.
+ */
+
+#ifndef SMARTMATRIX_FRAME_PACING_SAMPLES
+#define SMARTMATRIX_FRAME_PACING_SAMPLES    64
+#endif
+
+// all times in microseconds
+typedef struct smPacingPercentiles {
+    uint32_t min;
+    uint32_t median;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+    uint32_t mean;
+} smPacingPercentiles;
+
+typedef struct smFramePacingStats {
+    uint32_t framesSwapped;         // calls to swapBuffers()
+    uint32_t framesPresented;       // swaps that reached the panel
+    uint32_t framesDropped;         // swaps requested before the previous swap was displayed
+    uint32_t refreshFrames;         // frames refreshed on the panel
+    uint16_t samples;               // number of samples used for the percentiles below
+    smPacingPercentiles frameInterval;
+    smPacingPercentiles swapWait;
+    smPacingPercentiles presentLatency;
+    smPacingPercentiles presentInterval;
+} smFramePacingStats;
+
+template <int numSamples>
+class SMFramePacingTracker {
+    public:
+        static void trackLayer(const void * layer);
+        static void getStats(smFramePacingStats * stats);
+        static void reset(void);
+
+        // hooks called by the layers and refresh code
+        static uint32_t swapRequested(const void * layer, bool previousSwapPending);
+        static void swapQueued(const void * layer);
+        static void swapReturned(const void * layer, uint32_t requestTime);
+        static void swapPresented(const void * layer);
+        static void refreshFrameStarted(void);
+
+    private:
+        typedef struct sampleRing {
+            uint32_t samples[numSamples];
+            uint32_t count;
+        } sampleRing;
+
+        static bool isTracked(const void * layer);
+        static void addSample(volatile sampleRing * ring, uint32_t sample);
+        static uint16_t calculatePercentiles(volatile sampleRing * ring, smPacingPercentiles * percentiles);
+
+        static const void * volatile trackedLayer;
+
+        // written from loop()
+        static sampleRing frameIntervals;
+        static sampleRing swapWaits;
+        static uint32_t lastRequestTime;
+        static uint32_t framesSwapped;
+        static uint32_t framesDropped;
+
+        // written from the refresh ISR
+        static volatile sampleRing presentLatencies;
+        static volatile sampleRing presentIntervals;
+        static volatile uint32_t queuedTime;
+        static volatile uint32_t lastPresentTime;
+        static volatile uint32_t framesPresented;
+        static volatile uint32_t refreshFrames;
+};
+
+typedef SMFramePacingTracker<SMARTMATRIX_FRAME_PACING_SAMPLES> SMFramePacing;
+
+template <int numSamples>
+const void * volatile SMFramePacingTracker<numSamples>::trackedLayer = NULL;
+template <int numSamples>
+typename SMFramePacingTracker<numSamples>::sampleRing SMFramePacingTracker<numSamples>::frameIntervals;
+template <int numSamples>
+typename SMFramePacingTracker<numSamples>::sampleRing SMFramePacingTracker<numSamples>::swapWaits;
+template <int numSamples>
+uint32_t SMFramePacingTracker<numSamples>::lastRequestTime;
+template <int numSamples>
+uint32_t SMFramePacingTracker<numSamples>::framesSwapped;
+template <int numSamples>
+uint32_t SMFramePacingTracker<numSamples>::framesDropped;
+template <int numSamples>
+volatile typename SMFramePacingTracker<numSamples>::sampleRing SMFramePacingTracker<numSamples>::presentLatencies;
+template <int numSamples>
+volatile typename SMFramePacingTracker<numSamples>::sampleRing SMFramePacingTracker<numSamples>::presentIntervals;
+template <int numSamples>
+volatile uint32_t SMFramePacingTracker<numSamples>::queuedTime;
+template <int numSamples>
+volatile uint32_t SMFramePacingTracker<numSamples>::lastPresentTime;
+template <int numSamples>
+volatile uint32_t SMFramePacingTracker<numSamples>::framesPresented;
+template <int numSamples>
+volatile uint32_t SMFramePacingTracker<numSamples>::refreshFrames;
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::trackLayer(const void * layer) {
+    trackedLayer = layer;
+}
+
+template <int numSamples>
+inline bool SMFramePacingTracker<numSamples>::isTracked(const void * layer) {
+    return !trackedLayer || trackedLayer == layer;
+}
+
+template <int numSamples>
+inline void SMFramePacingTracker<numSamples>::addSample(volatile sampleRing * ring, uint32_t sample) {
+    ring->samples[ring->count % numSamples] = sample;
+    ring->count++;
+}
+
+template <int numSamples>
+uint32_t SMFramePacingTracker<numSamples>::swapRequested(const void * layer, bool previousSwapPending) {
+    uint32_t now = micros();
+
+    if(!isTracked(layer))
+        return now;
+
+    if(framesSwapped)
+        addSample(&frameIntervals, now - lastRequestTime);
+    lastRequestTime = now;
+    framesSwapped++;
+
+    if(previousSwapPending)
+        framesDropped++;
+
+    return now;
+}
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::swapQueued(const void * layer) {
+    if(isTracked(layer))
+        queuedTime = micros();
+}
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::swapReturned(const void * layer, uint32_t requestTime) {
+    if(isTracked(layer))
+        addSample(&swapWaits, micros() - requestTime);
+}
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::swapPresented(const void * layer) {
+    if(!isTracked(layer))
+        return;
+
+    uint32_t now = micros();
+
+    addSample(&presentLatencies, now - queuedTime);
+    if(framesPresented)
+        addSample(&presentIntervals, now - lastPresentTime);
+    lastPresentTime = now;
+    framesPresented++;
+}
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::refreshFrameStarted(void) {
+    refreshFrames++;
+}
+
+template <int numSamples>
+uint16_t SMFramePacingTracker<numSamples>::calculatePercentiles(volatile sampleRing * ring, smPacingPercentiles * percentiles) {
+    uint32_t sorted[numSamples];
+    uint16_t count;
+    uint64_t sum = 0;
+    int i, j;
+
+    // copy with interrupts disabled, the ISR may be adding samples
+    noInterrupts();
+    count = (ring->count < numSamples) ? ring->count : numSamples;
+    for(i=0; i<count; i++)
+        sorted[i] = ring->samples[i];
+    interrupts();
+
+    memset(percentiles, 0x00, sizeof(smPacingPercentiles));
+    if(!count)
+        return 0;
+
+    // insertion sort, the arrays are small
+    for(i=1; i<count; i++) {
+        uint32_t value = sorted[i];
+        for(j=i; j>0 && sorted[j-1] > value; j--)
+            sorted[j] = sorted[j-1];
+        sorted[j] = value;
+    }
+
+    for(i=0; i<count; i++)
+        sum += sorted[i];
+
+    percentiles->min = sorted[0];
+    percentiles->median = sorted[count/2];
+    percentiles->p90 = sorted[(count * 90) / 100];
+    percentiles->p99 = sorted[(count * 99) / 100];
+    percentiles->max = sorted[count-1];
+    percentiles->mean = sum / count;
+    return count;
+}
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::getStats(smFramePacingStats * stats) {
+    stats->framesSwapped = framesSwapped;
+    stats->framesDropped = framesDropped;
+    stats->framesPresented = framesPresented;
+    stats->refreshFrames = refreshFrames;
+    stats->samples = calculatePercentiles(&frameIntervals, &stats->frameInterval);
+    calculatePercentiles(&swapWaits, &stats->swapWait);
+    calculatePercentiles(&presentLatencies, &stats->presentLatency);
+    calculatePercentiles(&presentIntervals, &stats->presentInterval);
+}
+
+template <int numSamples>
+void SMFramePacingTracker<numSamples>::reset(void) {
+    noInterrupts();
+    frameIntervals.count = 0;
+    swapWaits.count = 0;
+    presentLatencies.count = 0;
+    presentIntervals.count = 0;
+    framesSwapped = 0;
+    framesDropped = 0;
+    framesPresented = 0;
+    refreshFrames = 0;
+    interrupts();
+}
+
+#endif
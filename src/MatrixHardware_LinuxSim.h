@@ -0,0 +1,149 @@
+/*
+ * SmartMatrix Library - Hardware-Specific Header File (for the Linux simulator)
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Note: only one MatrixHardware_*.h file should be included per project
+// included instead of Arduino.h and the shield's header when SMARTMATRIX_LINUX_SIM is defined, provides
+// the Arduino functions used by the library and a data format for MatrixDriver_LinuxSim.h to decode
+
+#ifndef MATRIX_HARDWARE_H
+#define MATRIX_HARDWARE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+
+// timing matches a Teensy 3.2 at 96MHz
+#ifndef F_CPU
+#define F_CPU   96000000
+#endif
+#ifndef F_BUS
+#define F_BUS   48000000
+#endif
+
+#define DMAMEM
+
+#define COLOR_CHANNELS_PER_PIXEL        3
+#define DMA_UPDATES_PER_CLOCK           2
+#define ADDX_UPDATE_BEFORE_LATCH_BYTES  1
+#define ADDX_UPDATE_ON_DATA_PINS
+
+// same timing as the SmartMatrix Shield V4
+#define LATCH_TIMER_PULSE_WIDTH_NS  438
+#define LATCH_TO_CLK_DELAY_NS       1400
+#define PANEL_32_PIXELDATA_TRANSFER_MAXIMUM_NS  (uint32_t)((2 * 3400 * 96000000.0) / F_CPU)
+
+// defines data bit order from bit 0-7, four times to fit in uint32_t
+// the address is written to bits 0-4 of the byte after the pixel data, so the order below makes it the low bits
+#define GPIO_WORD_ORDER p0r1:1, p0g1:1, p0b1:1, p0r2:1, p0g2:1, p0b2:1, p0clk:1, p0pad:1, \
+    p1r1:1, p1g1:1, p1b1:1, p1r2:1, p1g2:1, p1b2:1, p1clk:1, p1pad:1, \
+    p2r1:1, p2g1:1, p2b1:1, p2r2:1, p2g2:1, p2b2:1, p2clk:1, p2pad:1, \
+    p3r1:1, p3g1:1, p3b1:1, p3r2:1, p3g2:1, p3b2:1, p3clk:1, p3pad:1
+
+#define SM_SIM_BIT_R1   (1 << 0)
+#define SM_SIM_BIT_G1   (1 << 1)
+#define SM_SIM_BIT_B1   (1 << 2)
+#define SM_SIM_BIT_R2   (1 << 3)
+#define SM_SIM_BIT_G2   (1 << 4)
+#define SM_SIM_BIT_B2   (1 << 5)
+#define SM_SIM_ADDRESS_MASK 0x1F
+
+// Arduino functions used by the library
+
+static inline uint64_t smSimNanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline uint32_t millis(void) {
+    return smSimNanoseconds() / 1000000;
+}
+
+static inline uint32_t micros(void) {
+    return smSimNanoseconds() / 1000;
+}
+
+static inline void delay(uint32_t ms) {
+    struct timespec duration = { (time_t)(ms / 1000), (long)((ms % 1000) * 1000000) };
+    nanosleep(&duration, NULL);
+}
+
+// the refresh thread holds this lock while running the "ISRs", noInterrupts() holds them off
+static inline std::recursive_mutex & smSimInterruptLock(void) {
+    static std::recursive_mutex lock;
+    return lock;
+}
+
+static inline void noInterrupts(void) {
+    smSimInterruptLock().lock();
+}
+
+static inline void interrupts(void) {
+    smSimInterruptLock().unlock();
+}
+
+// enough of Print for SMTrace::dump() and countFPS()
+class Print {
+    public:
+        virtual size_t write(uint8_t c) = 0;
+        size_t write(const uint8_t * buffer, size_t size) {
+            size_t i;
+            for(i=0; i<size; i++)
+                write(buffer[i]);
+            return size;
+        }
+        size_t print(const char * text) {
+            return write((const uint8_t *)text, strlen(text));
+        }
+        size_t print(long value) {
+            char text[12];
+            snprintf(text, sizeof(text), "%ld", value);
+            return print(text);
+        }
+        size_t println(const char * text) {
+            return print(text) + print("\n");
+        }
+        size_t println(long value) {
+            return print(value) + print("\n");
+        }
+};
+
+// Serial goes to stdout
+class SMSimSerial : public Print {
+    public:
+        using Print::write;
+        size_t write(uint8_t c) {
+            return fwrite(&c, 1, 1, stdout);
+        }
+        operator bool() {
+            return true;
+        }
+};
+
+extern SMSimSerial Serial;
+#define USB_SERIAL
+
+#endif
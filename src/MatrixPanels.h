@@ -0,0 +1,103 @@
+/*
+ * SmartMatrix Library - HUB75 Panel Descriptions
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_PANELS_H_
+#define _MATRIX_PANELS_H_
+
+#include <stdint.h>
+
+/*
+  A HUB75 panel is driven as two halves, the top half from R1/G1/B1 and the bottom half from R2/G2/B2.  Each row
+  address lights height/(2*rowsPerFrame) rows in each half, rowsPerFrame rows apart: one row for the common 1/16
+  scan 32-row panels, two rows for 1/4 scan 16-row and 1/8 scan 32-row outdoor panels.
+
+  All the rows lit by an address share one shift register per color, so pixels are shifted in blocks of blockWidth
+  pixels, alternating between the rows lit by the address.  e.g. a 1/4 scan panel with 8 pixel blocks lit at
+  address 0 shifts x 0-7 of one row, then x 0-7 of the row four rows below, then x 8-15 of the first row...
+  blockWidth of 0 shifts out whole rows one after the other.
+
+  The refresh code turns the description into a table giving, for every pixel in the order it's shifted, where to
+  find it in the composited row.  The table also handles C-shape stacking, so packing is one indexed read per pixel.
+
+  To use a panel not in the table, describe it with SMARTMATRIX_CUSTOM_PANEL_DESCRIPTION before including
+  SmartMatrix3.h and use SMARTMATRIX_HUB75_CUSTOM as the panel type.
+ */
+
+// blocks start with the lowest row lit by the address instead of the highest
+#define SM_PANEL_BLOCK_LOWER_ROW_FIRST      (1 << 0)
+// every other block is shifted right to left
+#define SM_PANEL_BLOCK_ZIGZAG               (1 << 1)
+
+typedef struct smPanelDescription {
+    uint8_t height;             // rows of LEDs on the panel
+    uint8_t rowsPerFrame;       // row addresses scanned, e.g. 16 for 1/16 scan
+    uint8_t blockWidth;         // pixels shifted from one row before moving to the next row lit by the same address
+    uint8_t blockFlags;         // SM_PANEL_BLOCK_*
+} smPanelDescription;
+
+#define SMARTMATRIX_HUB75_32ROW_MOD16SCAN   0
+#define SMARTMATRIX_HUB75_16ROW_MOD8SCAN    1
+#define SMARTMATRIX_HUB75_64ROW_MOD32SCAN   2
+#define SMARTMATRIX_HUB75_16ROW_MOD4SCAN    3
+#define SMARTMATRIX_HUB75_32ROW_MOD8SCAN    4
+#define SMARTMATRIX_HUB75_CUSTOM            5
+
+#ifndef SMARTMATRIX_CUSTOM_PANEL_DESCRIPTION
+#define SMARTMATRIX_CUSTOM_PANEL_DESCRIPTION    { 32, 16, 0, 0 }
+#endif
+
+// indexed by panel type
+static constexpr smPanelDescription smPanelDescriptions[] = {
+    { 32, 16, 0, 0 },                               // SMARTMATRIX_HUB75_32ROW_MOD16SCAN
+    { 16,  8, 0, 0 },                               // SMARTMATRIX_HUB75_16ROW_MOD8SCAN
+    { 64, 32, 0, 0 },                               // SMARTMATRIX_HUB75_64ROW_MOD32SCAN
+    { 16,  4, 8, SM_PANEL_BLOCK_LOWER_ROW_FIRST },  // SMARTMATRIX_HUB75_16ROW_MOD4SCAN, e.g. outdoor P10
+    { 32,  8, 8, SM_PANEL_BLOCK_LOWER_ROW_FIRST },  // SMARTMATRIX_HUB75_32ROW_MOD8SCAN, e.g. outdoor P8
+    SMARTMATRIX_CUSTOM_PANEL_DESCRIPTION,           // SMARTMATRIX_HUB75_CUSTOM
+};
+
+#define CONVERT_PANELTYPE_TO_MATRIXPANELHEIGHT(x)       (smPanelDescriptions[x].height)
+#define CONVERT_PANELTYPE_TO_MATRIXROWPAIROFFSET(x)     (smPanelDescriptions[x].height / 2)
+#define CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(x)      (smPanelDescriptions[x].rowsPerFrame)
+// rows lit in each half of the panel by one row address
+#define CONVERT_PANELTYPE_TO_MATRIXROWSPERADDRESS(x)    (smPanelDescriptions[x].height / (2 * smPanelDescriptions[x].rowsPerFrame))
+
+// position is the order pixels are shifted into one half of a row of panels matrixWidth wide, returns the x coordinate
+// and which of the rows lit by the address it belongs to (0 is the row at the address, 1 is rowsPerFrame rows below...)
+static inline uint16_t smPanelPixelPosition(const smPanelDescription & panel, uint16_t matrixWidth, uint16_t position, uint8_t * subRow) {
+    uint8_t rowsPerAddress = panel.height / (2 * panel.rowsPerFrame);
+    uint16_t blockWidth = panel.blockWidth ? panel.blockWidth : matrixWidth;
+    uint16_t block = position / blockWidth;
+    uint16_t column = position % blockWidth;
+
+    *subRow = block % rowsPerAddress;
+    if(panel.blockFlags & SM_PANEL_BLOCK_LOWER_ROW_FIRST)
+        *subRow = rowsPerAddress - *subRow - 1;
+
+    if((panel.blockFlags & SM_PANEL_BLOCK_ZIGZAG) && (block % 2))
+        column = blockWidth - column - 1;
+
+    return (block / rowsPerAddress) * blockWidth + column;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * SmartMatrix Library - Shared Memory Preview Format
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_PREVIEW_H_
+#define _MATRIX_PREVIEW_H_
+
+#include <stdint.h>
+
+/*
+  Layout of the shared memory preview written by the Linux simulator (see MatrixDriver_LinuxSim.h), for viewers and
+  tests that map it read-only.  extras/tools/smpreview.py is a viewer, and must be kept in sync with this file.
+
+  The shared memory object starts with an smPreviewHeader, followed by slotCount slots every slotSize bytes starting at
+  headerSize.  Each slot is an smPreviewSlot followed by width * height rgb24 pixels (3 bytes each, red first) in
+  hardware coordinates: after the layers' rotation has been applied and with the panel order undone, so the image is
+  laid out as the panels are seen and viewers shouldn't rotate it again.  Each frame refreshed is written to the next
+  slot in turn.
+
+  A slot's sequence is odd while it's being written.  To read a frame consistently: read latestFrame, read the
+  sequence of slot (latestFrame - 1) % slotCount and retry if it's odd, copy the slot, then read the sequence again and
+  retry if it changed.
+ */
+
+#define SM_PREVIEW_MAGIC        0x56504D53  // "SMPV"
+#define SM_PREVIEW_VERSION      1
+
+// default name of the shared memory object, shows up as /dev/shm/smartmatrix
+#define SM_PREVIEW_DEFAULT_NAME "/smartmatrix"
+
+#ifndef SMARTMATRIX_PREVIEW_SLOTS
+#define SMARTMATRIX_PREVIEW_SLOTS   4
+#endif
+
+typedef struct smPreviewHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;            // offset of the first slot
+    uint16_t width;
+    uint16_t height;
+    uint16_t slotCount;
+    uint16_t reserved0;
+    uint32_t slotSize;              // offset from one slot to the next
+    volatile uint32_t latestFrame;  // number of the last frame written, 0 before the first frame
+    uint32_t reserved1[2];
+} smPreviewHeader;
+
+typedef struct smPreviewSlot {
+    volatile uint32_t sequence;     // odd while the slot is being written
+    uint32_t frame;                 // frames are numbered from 1
+    uint64_t timestamp;             // CLOCK_MONOTONIC in nanoseconds, when the last row of the frame was refreshed
+    uint32_t rowsRefreshed;         // rows refreshed since begin(), when the frame was written
+    uint32_t reserved;
+} smPreviewSlot;
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * SmartMatrix Library - Refresh Profiling
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_PROFILING_H_
+#define _MATRIX_PROFILING_H_
+
+#include <stdint.h>
+
+/*
+  Profiling of the refresh code, to find which layer is eating the CPU.  To collect profiles, add this line
+  before including SmartMatrix3.h:
+    #define SMARTMATRIX_PROFILING_ENABLED
+
+  With profiling enabled, the refresh code measures the time spent in each layer's frameRefreshCallback()
+  (once per frame) and fillRefreshRow() (once per row, all calls for that row counted as one sample), and the
+  time spent packing each row into the DMA buffer.  Results are read with SmartMatrix3::getLayerProfile() and
+  getPackingProfile(), layers are numbered in the order they were added with addLayer().  Frame and row callbacks
+  (SMARTMATRIX_ROW_CALLBACKS_ENABLED) are timed separately from the layers, read with getCallbackProfile().
+
+  Times are in ticks of the CPU cycle counter, SM_PROFILING_TICKS_PER_SECOND ticks per second.  The overhead is a
+  couple reads of the cycle counter and a few adds per sample, small enough to leave enabled.
+ */
+
+// layers past this number (in the order they were added) aren't profiled
+#ifndef SMARTMATRIX_PROFILING_MAX_LAYERS
+#define SMARTMATRIX_PROFILING_MAX_LAYERS    8
+#endif
+
+typedef struct smProfileCounter {
+    uint64_t total;     // sum of all samples
+    uint32_t max;       // longest single sample
+    uint32_t count;     // number of samples
+} smProfileCounter;
+
+typedef struct smLayerProfile {
+    smProfileCounter frameRefreshCallback;
+    smProfileCounter fillRefreshRow;
+} smLayerProfile;
+
+typedef struct smCallbackProfile {
+    smProfileCounter frameCallback;     // once per frame
+    smProfileCounter rowCallbacks;      // once per row, all row callbacks for that row counted as one sample
+} smCallbackProfile;
+
+#define SM_PROFILING_TICKS_PER_SECOND   F_CPU
+
+#ifdef SMARTMATRIX_LINUX_SIM
+// no cycle counter, count F_CPU ticks from the monotonic clock so the units match
+static inline void smProfilingBegin(void) {
+}
+
+static inline uint32_t smProfilingTimestamp(void) {
+    return (smSimNanoseconds() * (F_CPU / 1000000)) / 1000;
+}
+#else
+// start the Cortex-M4 cycle counter, it isn't running by default
+static inline void smProfilingBegin(void) {
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+static inline uint32_t smProfilingTimestamp(void) {
+    return ARM_DWT_CYCCNT;
+}
+#endif
+
+static inline void smProfileCounterAdd(smProfileCounter * counter, uint32_t ticks) {
+    counter->total += ticks;
+    counter->count++;
+    if(ticks > counter->max)
+        counter->max = ticks;
+}
+
+#endif
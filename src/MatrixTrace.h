@@ -0,0 +1,218 @@
+/*
+ * SmartMatrix Library - Refresh Event Trace
+ *
+ * Copyright (c) 2015 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MATRIX_TRACE_H_
+#define _MATRIX_TRACE_H_
+
+#include <stdint.h>
+#include "MatrixProfiling.h"
+
+/*
+  Fixed-size ring buffer of timestamped refresh events, for finding out what happened before a glitch
+  (underrun, refresh rate drop, swap stall) after the fact.  To record library events, add this line
+  before including SmartMatrix3.h:
+    #define SMARTMATRIX_TRACE_ENABLED
+
+  Logging an event is a counter increment and an 8-byte store, so it can be left on in production.
+  The buffer keeps the most recent SMARTMATRIX_TRACE_EVENTS events (must be a power of two).  Per-row
+  events fill the buffer quickly, so they're masked off by default, enable with SMTrace::setEventMask().
+  SMTrace::stopOnEvent(smTraceUnderrun) freezes the buffer after the first underrun, preserving the events
+  leading up to it.
+
+  SMTrace::dump(Serial) writes the buffer in binary, decode with extras/tools/smtrace_decode.py.
+  Dump format, little-endian:
+    header: "SMTR", uint8_t version, uint8_t event size, uint16_t number of events,
+            uint32_t timestamp ticks per second, uint32_t total events logged
+    events: smTraceEvent[number of events], oldest first
+ */
+
+#ifndef SMARTMATRIX_TRACE_EVENTS
+#define SMARTMATRIX_TRACE_EVENTS    128
+#endif
+
+#define SM_TRACE_DUMP_VERSION       1
+
+typedef enum smTraceEventType {
+    smTraceNone = 0,
+    smTraceFrameStart,              // arg1: refresh rate
+    smTraceRowCalculationStart,     // arg0: rows waiting in DMA buffer
+    smTraceRowCalculationEnd,       // arg0: rows calculated
+    smTraceRowShiftComplete,        // arg0: rows left in DMA buffer
+    smTraceUnderrun,
+    smTraceUnderrunRecovered,       // arg1: refresh rate
+    smTraceRefreshRateLowered,      // arg1: new refresh rate
+    smTraceBrightnessChange,        // arg1: dimming factor
+    smTraceRotationChange,          // arg0: rotation
+    smTraceSwapRequested,           // arg0: smTraceLayerType
+    smTraceSwapComplete,            // arg0: smTraceLayerType
+    smTraceDmaBufferRowsChange,     // arg0: rows in use, arg1: smDmaBufferRowsChange reason
+    smTraceCallbackOverrun,         // arg0: row callback slot (0xFF for the frame callback), arg1: ticks taken (saturated)
+    smTraceBrightnessFadeStep,      // arg0: fade step, arg1: light output (out of 65535)
+    smTraceUser = 24,               // first event type free for sketches, up to 31
+} smTraceEventType;
+
+typedef enum smTraceLayerType {
+    smTraceLayerBackground = 0,
+    smTraceLayerIndexed,
+    smTraceLayerScaled,
+    smTraceLayerRemap,
+} smTraceLayerType;
+
+#define SM_TRACE_MASK(type)         (1UL << (type))
+#define SM_TRACE_ROW_EVENTS         (SM_TRACE_MASK(smTraceRowCalculationStart) | SM_TRACE_MASK(smTraceRowCalculationEnd) | \
+                                     SM_TRACE_MASK(smTraceRowShiftComplete))
+#define SM_TRACE_DEFAULT_MASK       (0xFFFFFFFF & ~SM_TRACE_ROW_EVENTS)
+
+typedef struct smTraceEvent {
+    uint32_t timestamp;             // SM_PROFILING_TICKS_PER_SECOND ticks
+    uint8_t type;
+    uint8_t arg0;
+    uint16_t arg1;
+} smTraceEvent;
+
+template <int numEvents>
+class SMTraceBuffer {
+    public:
+        static void log(uint8_t type, uint8_t arg0 = 0, uint16_t arg1 = 0);
+
+        static void setEventMask(uint32_t mask);
+        // stop recording after an event of this type is logged, smTraceNone to never stop
+        static void stopOnEvent(uint8_t type);
+        static void start(void);
+        static void stop(void);
+
+        static uint16_t getNumEvents(void);
+        static uint32_t getTotalEventsLogged(void);
+        // index 0 is the oldest event in the buffer
+        static bool readEvent(uint16_t index, smTraceEvent * event);
+        static void dump(Print & output);
+
+    private:
+        static_assert(numEvents && !(numEvents & (numEvents - 1)), "SMARTMATRIX_TRACE_EVENTS must be a power of two");
+
+        static smTraceEvent events[numEvents];
+        static volatile uint32_t eventsLogged;
+        static volatile uint32_t eventMask;
+        static volatile uint8_t stopEvent;
+        static volatile bool running;
+};
+
+typedef SMTraceBuffer<SMARTMATRIX_TRACE_EVENTS> SMTrace;
+
+#ifdef SMARTMATRIX_TRACE_ENABLED
+#define SM_TRACE(type, arg0, arg1)  SMTrace::log((type), (arg0), (arg1))
+#else
+#define SM_TRACE(type, arg0, arg1)
+#endif
+
+template <int numEvents>
+smTraceEvent SMTraceBuffer<numEvents>::events[numEvents];
+template <int numEvents>
+volatile uint32_t SMTraceBuffer<numEvents>::eventsLogged = 0;
+template <int numEvents>
+volatile uint32_t SMTraceBuffer<numEvents>::eventMask = SM_TRACE_DEFAULT_MASK;
+template <int numEvents>
+volatile uint8_t SMTraceBuffer<numEvents>::stopEvent = smTraceNone;
+template <int numEvents>
+volatile bool SMTraceBuffer<numEvents>::running = true;
+
+template <int numEvents>
+inline void SMTraceBuffer<numEvents>::log(uint8_t type, uint8_t arg0, uint16_t arg1) {
+    if(!running || !(eventMask & SM_TRACE_MASK(type)))
+        return;
+
+    // claim a slot atomically, events may be logged from ISRs of different priorities
+    smTraceEvent * event = &events[__sync_fetch_and_add(&eventsLogged, 1) & (numEvents - 1)];
+    event->timestamp = smProfilingTimestamp();
+    event->type = type;
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+
+    if(type == stopEvent)
+        running = false;
+}
+
+template <int numEvents>
+void SMTraceBuffer<numEvents>::setEventMask(uint32_t mask) {
+    eventMask = mask;
+}
+
+template <int numEvents>
+void SMTraceBuffer<numEvents>::stopOnEvent(uint8_t type) {
+    stopEvent = type;
+}
+
+template <int numEvents>
+void SMTraceBuffer<numEvents>::start(void) {
+    running = true;
+}
+
+template <int numEvents>
+void SMTraceBuffer<numEvents>::stop(void) {
+    running = false;
+}
+
+template <int numEvents>
+uint16_t SMTraceBuffer<numEvents>::getNumEvents(void) {
+    return (eventsLogged < numEvents) ? eventsLogged : numEvents;
+}
+
+template <int numEvents>
+uint32_t SMTraceBuffer<numEvents>::getTotalEventsLogged(void) {
+    return eventsLogged;
+}
+
+template <int numEvents>
+bool SMTraceBuffer<numEvents>::readEvent(uint16_t index, smTraceEvent * event) {
+    if(index >= getNumEvents())
+        return false;
+
+    *event = events[(eventsLogged - getNumEvents() + index) & (numEvents - 1)];
+    return true;
+}
+
+// recording is paused during the dump so the events written are consistent with the header
+template <int numEvents>
+void SMTraceBuffer<numEvents>::dump(Print & output) {
+    bool wasRunning = running;
+    running = false;
+
+    uint16_t count = getNumEvents();
+    uint32_t ticksPerSecond = SM_PROFILING_TICKS_PER_SECOND;
+    uint32_t totalLogged = eventsLogged;
+    uint8_t header[16] = { 'S', 'M', 'T', 'R', SM_TRACE_DUMP_VERSION, sizeof(smTraceEvent),
+        (uint8_t)count, (uint8_t)(count >> 8),
+        (uint8_t)ticksPerSecond, (uint8_t)(ticksPerSecond >> 8), (uint8_t)(ticksPerSecond >> 16), (uint8_t)(ticksPerSecond >> 24),
+        (uint8_t)totalLogged, (uint8_t)(totalLogged >> 8), (uint8_t)(totalLogged >> 16), (uint8_t)(totalLogged >> 24) };
+    output.write(header, sizeof(header));
+
+    smTraceEvent event;
+    for(uint16_t i=0; i<count; i++) {
+        readEvent(i, &event);
+        output.write((const uint8_t *)&event, sizeof(event));
+    }
+
+    running = wasRunning;
+}
+
+#endif
@@ -23,11 +23,33 @@
 
 #include "SmartMatrix3.h"
 
+#ifdef SMARTMATRIX_LINUX_SIM
+SMSimSerial Serial;
+
+smDriverConfig SMDriverLinuxSim::config;
+std::thread SMDriverLinuxSim::refreshThread;
+volatile bool SMDriverLinuxSim::running = false;
+volatile bool SMDriverLinuxSim::realtime = true;
+const matrixUpdateBlock * SMDriverLinuxSim::nextBlocks;
+const uint8_t * SMDriverLinuxSim::nextData;
+const timerpair * SMDriverLinuxSim::idleTimer = NULL;
+bool SMDriverLinuxSim::rowCalculationPending = false;
+rgb24 * SMDriverLinuxSim::framebuffer = NULL;
+volatile uint32_t SMDriverLinuxSim::rowsRefreshed = 0;
+volatile uint32_t SMDriverLinuxSim::framesRefreshed = 0;
+uint64_t SMDriverLinuxSim::ticksRefreshed = 0;
+uint64_t SMDriverLinuxSim::firstFrameTicks = 0;
+uint64_t SMDriverLinuxSim::lastFrameTicks = 0;
+smPreviewHeader * SMDriverLinuxSim::preview = NULL;
+size_t SMDriverLinuxSim::previewSize;
+char SMDriverLinuxSim::previewName[64];
+#else
 #ifndef ADDX_UPDATE_ON_DATA_PINS
 DMAChannel dmaOutputAddress(false);
 DMAChannel dmaUpdateAddress(false);
 #endif
 DMAChannel dmaUpdateTimer(false);
 DMAChannel dmaClockOutData(false);
+#endif
 
 CircularBuffer dmaBuffer;
@@ -26,34 +26,105 @@
 
 #include <stdint.h>
 
-#include "Arduino.h"
+// building for Linux instead of Teensy: refresh a simulated panel, see MatrixDriver_LinuxSim.h
+#if defined(__linux__) && !defined(ARDUINO) && !defined(SMARTMATRIX_LINUX_SIM)
+    #define SMARTMATRIX_LINUX_SIM
+#endif
 
-#ifdef V4HEADER
-    #include "MatrixHardware_KitV4.h"
+#ifdef SMARTMATRIX_LINUX_SIM
+    #include "MatrixHardware_LinuxSim.h"
 #else
-    #include "MatrixHardware_KitV1.h"
+    #include "Arduino.h"
+
+    #ifdef V4HEADER
+        #include "MatrixHardware_KitV4.h"
+    #else
+        #include "MatrixHardware_KitV1.h"
+    #endif
 #endif
 
 #include "MatrixCommon.h"
+#include "CircularBuffer.h"
+#include "MatrixProfiling.h"
+#include "MatrixTrace.h"
+#include "MatrixFramePacing.h"
+#include "MatrixFilters.h"
 
 #include "Layer_Scrolling.h"
 #include "Layer_Indexed.h"
 #include "Layer_Background.h"
+#include "Layer_Scaled.h"
+#include "Layer_Remap.h"
+
+#include "MatrixPanels.h"
+#include "MatrixDriver.h"
+
+// number of HUB75 chains shifted out at the same time, each driving an equal share of the stacked panels (top chain first)
+// the chains share clock, latch, OE and address pins, and each DMA transfer writes one byte per chain
+#ifndef SMARTMATRIX_PARALLEL_CHAINS
+#define SMARTMATRIX_PARALLEL_CHAINS     1
+#endif
+
+// number of rows composited ahead when SMARTMATRIX_PREFETCH_ENABLED is defined, see SmartMatrix3::prefetchRows()
+#ifndef SMARTMATRIX_PREFETCH_ROWS
+#define SMARTMATRIX_PREFETCH_ROWS   4
+#endif
+
+// number of static layers that can be cached when SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED is defined
+// each cache uses matrixWidth * matrixHeight refresh pixels (6 bytes each, 3 bytes for 24-bit refresh) plus a bit per pixel
+#ifndef SMARTMATRIX_STATIC_LAYER_CACHES
+#define SMARTMATRIX_STATIC_LAYER_CACHES     2
+#endif
+
+// number of row callbacks that can be registered when SMARTMATRIX_ROW_CALLBACKS_ENABLED is defined
+#ifndef SMARTMATRIX_ROW_CALLBACKS
+#define SMARTMATRIX_ROW_CALLBACKS   4
+#endif
 
-typedef struct timerpair {
-    uint16_t timer_oe;
-    uint16_t timer_period;
-} timerpair;
+// CPU cycles the row callbacks may take together for one row, and the frame callback for one frame
+// a row over budget loses the row callback that took longest in it, and a frame callback over budget is removed
+#ifndef SMARTMATRIX_ROW_CALLBACK_BUDGET
+#define SMARTMATRIX_ROW_CALLBACK_BUDGET     (F_CPU / 1000000 * 2)
+#endif
+#ifndef SMARTMATRIX_FRAME_CALLBACK_BUDGET
+#define SMARTMATRIX_FRAME_CALLBACK_BUDGET   (F_CPU / 1000000 * 50)
+#endif
+
+// number of steps a fade is divided into when SMARTMATRIX_BRIGHTNESS_FADE_ENABLED is defined, see SmartMatrix3::fadeTo()
+// the timer values for each step are worked out when the fade starts, 2 bytes per latch (refreshDepth/3) per step
+#ifndef SMARTMATRIX_BRIGHTNESS_FADE_STEPS
+#define SMARTMATRIX_BRIGHTNESS_FADE_STEPS   32
+#endif
 
-typedef struct addresspair {
-    uint16_t bits_to_clear;
-    uint16_t bits_to_set;
-} addresspair;
+// called from the refresh code before each row is composited, with the row in hardware coordinates (before rotation)
+typedef void (*smRowCallback)(uint16_t hardwareY);
+// called from the refresh code at the start of each frame, before the layers' frameRefreshCallback()
+typedef void (*smFrameCallback)(void);
+
+// reason for the last change to the number of DMA buffer rows in use
+typedef enum smDmaBufferRowsChange {
+    smDmaBufferRowsAllocated = 0,   // initial value, all rows allocated with SMARTMATRIX_ALLOCATE_BUFFERS()
+    smDmaBufferRowsUser,            // set by setDmaBufferRows()
+    smDmaBufferRowsUnderrun,        // adaptive: grown after a DMA buffer underrun
+    smDmaBufferRowsUnused,          // adaptive: shrunk after the spare rows went unused
+} smDmaBufferRowsChange;
+
+// how SmartMatrix3::fadeTo() moves between brightnesses
+typedef enum smFadeCurve {
+    smFadeCurveLinear = 0,          // equal steps of light output
+    smFadeCurvePerceptual,          // steps that look equal, slower at the dark end
+} smFadeCurve;
+
+// rows are composited at 16 bits per color channel, except for 24-bit refresh (8 latches per row) which only needs 8
+template <int latchesPerRow>
+struct smRefreshPixel {
+    typedef rgb48 type;
+};
 
-typedef struct matrixUpdateBlock {
-    timerpair timerValues;
-    addresspair addressValues;
-} matrixUpdateBlock;
+template <>
+struct smRefreshPixel<8> {
+    typedef rgb24 type;
+};
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 class SmartMatrix3 {
@@ -63,10 +134,18 @@ public:
     void begin(void);
     void addLayer(SM_Layer * newlayer);
 
+    // layers are composited in order from the bottom, addLayer() puts a layer on top.  insertLayer() adds a layer directly
+    // above another, or at the bottom if below is NULL, and moves the layer if it was already added.  Changes to the order
+    // take effect at the start of the next frame, so a frame is never composited from a mix of the old and new order
+    void insertLayer(SM_Layer * layer, SM_Layer * below);
+    void removeLayer(SM_Layer * layer);
+
     // configuration
     void setRotation(rotationDegrees rotation);
     void setBrightness(uint8_t brightness);
     void setRefreshRate(uint8_t newRefreshRate);
+    void setDmaBufferRows(uint8_t rows);
+    void setDmaBufferRowsAdaptive(bool enabled);
 
     // get info
     uint16_t getScreenWidth(void) const;
@@ -74,12 +153,44 @@ public:
     uint8_t getRefreshRate(void);
     bool getdmaBufferUnderrunFlag(void);
     bool getRefreshRateLoweredFlag(void);
+    uint8_t getDmaBufferRows(void);
+    smDmaBufferRowsChange getDmaBufferRowsChangeReason(void);
+
+    // rows changed by any layer at the start of the frame being refreshed, in hardware coordinates (before rotation)
+    bool isRowDirty(uint16_t hardwareY);
+    uint16_t getDirtyRowCount(void);
 
-    // debug
+    // debug - prints loop() iterations per second, see MatrixFramePacing.h for swap timing statistics that don't print
     void countFPS(void);
 
+    // profiling - only collected when SMARTMATRIX_PROFILING_ENABLED is defined, otherwise these return false
+    bool getLayerProfile(uint8_t layerIndex, smLayerProfile * profile);
+    bool getPackingProfile(smProfileCounter * profile);
+    bool getCallbackProfile(smCallbackProfile * profile);
+    void resetProfiles(void);
+
+    // prefetch - composite rows ahead of the refresh ISR, only available when SMARTMATRIX_PREFETCH_ENABLED is defined
+    void prefetchRows(void);
+    uint8_t getPrefetchedRows(void);
+
+    // raster callbacks - change layer parameters row by row, only available when SMARTMATRIX_ROW_CALLBACKS_ENABLED is defined
+    bool addRowCallback(smRowCallback callback);
+    void removeRowCallback(smRowCallback callback);
+    void setFrameCallback(smFrameCallback callback);
+    bool getCallbackOverrunFlag(void);
+
+    // brightness fades - change the brightness of the whole display over a number of frames by switching between timer
+    // values worked out when the fade starts, without touching pixel data.  Only available when
+    // SMARTMATRIX_BRIGHTNESS_FADE_ENABLED is defined, otherwise fadeTo() changes brightness at once.  setBrightness() stops a fade
+    void fadeTo(uint8_t brightness, uint16_t frames, smFadeCurve curve = smFadeCurvePerceptual);
+    bool isFading(void);
+
 private:
     SM_Layer * baseLayer;
+    // the order changed by addLayer(), insertLayer() and removeLayer(), copied to baseLayer/nextLayer at the next frame
+    SM_Layer * pendingBaseLayer;
+    static volatile bool layerOrderChange;
+    void unlinkPendingLayer(SM_Layer * layer);
 
     // enable ISR access to private member variables
     template <int refreshDepth1, int matrixWidth1, int matrixHeight1, unsigned char panelType1, unsigned char optionFlags1>
@@ -91,13 +202,42 @@ private:
     static void matrixCalculations(bool initial = false);
 
     // functions for refreshing
+    typedef typename smRefreshPixel<refreshDepth/COLOR_CHANNELS_PER_PIXEL>::type refreshPixel;
+
     static void loadMatrixBuffers(unsigned char currentRow);
-    static void loadMatrixBuffers48(unsigned char currentRow, unsigned char freeRowBuffer);
-    static void loadMatrixBuffers36(unsigned char currentRow, unsigned char freeRowBuffer);
-    static void loadMatrixBuffers24(unsigned char currentRow, unsigned char freeRowBuffer);
+    static void packRow(unsigned char currentRow, unsigned char freeRowBuffer, rgb48 tempRow0[], rgb48 tempRow1[]);
+    static void packRow(unsigned char currentRow, unsigned char freeRowBuffer, rgb24 tempRow0[], rgb24 tempRow1[]);
+    static void loadMatrixBuffers48(unsigned char currentRow, unsigned char freeRowBuffer, rgb48 tempRow0[], rgb48 tempRow1[]);
+    static void loadMatrixBuffers36(unsigned char currentRow, unsigned char freeRowBuffer, rgb48 tempRow0[], rgb48 tempRow1[]);
+    static void loadMatrixBuffers24(unsigned char currentRow, unsigned char freeRowBuffer, rgb24 tempRow0[], rgb24 tempRow1[]);
+    static void composeNextRow(refreshPixel tempRow0[], refreshPixel tempRow1[]);
+    static void fillRowFromLayers(unsigned char currentRow, refreshPixel tempRow0[], refreshPixel tempRow1[]);
+    static void fillLayerRow(SM_Layer * layer, uint16_t hardwareY, refreshPixel refreshRow[]);
+    static void updateDirtyRows(void);
+    static void applyLayerOrder(void);
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+    static void runFrameCallback(void);
+    static void runRowCallbacks(uint16_t hardwareY);
+#endif
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+    static void updateStaticLayerCache(SM_Layer * layer, const uint8_t layerDirtyRows[]);
+    static bool fillRowFromCache(SM_Layer * layer, uint16_t hardwareY, refreshPixel refreshRow[]);
+#endif
 
     // configuration helper functions
     static void calculateTimerLut(void);
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    static void calculateFadeTimerLuts(void);
+    static void updateFade(void);
+#endif
+    static void calculatePixelRemap(void);
+    static void changeDmaBufferRows(uint8_t rows, smDmaBufferRowsChange reason);
+
+    // location of a row in the DMA buffer, passed to the driver
+    static matrixUpdateBlock * getRowBlocks(unsigned char bufferRow);
+    static uint8_t * getRowData(unsigned char bufferRow);
+    static void storePixelWord(unsigned char freeRowBuffer, uint16_t pixel, uint8_t word, uint32_t data, uint32_t clock);
+    static void storeAddressWords(unsigned char freeRowBuffer, uint32_t data);
 
     // configuration
     static volatile bool brightnessChange;
@@ -108,17 +248,24 @@ private:
     static rotationDegrees rotation;
     static uint8_t colorDepthRgb;
     static uint8_t refreshRate;
+    static uint32_t rowTicksError;          // fraction of a tick carried to the next row, out of ROWS_PER_SECOND
     static const int matrixPanelHeight;    
     static const int matrixRowPairOffset;    
     static const int matrixRowsPerFrame;    
+    static uint16_t pixelRemap[];           // position in the composited row of each pixel, in the order they're shifted
 
     const static uint8_t latchesPerRow = refreshDepth/COLOR_CHANNELS_PER_PIXEL;
     static uint8_t dmaBufferNumRows;
-    static uint8_t dmaBufferBytesPerPixel;
+    static volatile uint8_t dmaBufferActiveRows;
+    static volatile bool dmaBufferRowsAdaptive;
+    static volatile smDmaBufferRowsChange dmaBufferRowsChangeReason;
+    static uint16_t dmaBufferBytesPerPixel;
     static uint16_t dmaBufferBytesPerRow;
     static bool dmaBufferUnderrunSinceLastCheck;
     static bool refreshRateLowered;
     static bool refreshRateChanged;
+    static unsigned char composeRow;
+    static uint8_t frameDirtyRows[(matrixHeight + 7) / 8];     // bit per row
 
     static uint32_t * matrixUpdateData;
     static matrixUpdateBlock * matrixUpdateBlocks;
@@ -127,23 +274,46 @@ private:
     static timerpair * timerPairIdle;
 
     static SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>* globalinstance;
-};
 
-#define SMARTMATRIX_HUB75_32ROW_MOD16SCAN   0
-#define SMARTMATRIX_HUB75_16ROW_MOD8SCAN    1
-#define SMARTMATRIX_HUB75_64ROW_MOD32SCAN   2
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    static smLayerProfile layerProfiles[SMARTMATRIX_PROFILING_MAX_LAYERS];
+    static smProfileCounter packingProfile;
+    static smCallbackProfile callbackProfile;
+#endif
 
-#define CONVERT_PANELTYPE_TO_MATRIXPANELHEIGHT(x)   ((x == SMARTMATRIX_HUB75_32ROW_MOD16SCAN ? 32 : 0) | \
-                                                     (x == SMARTMATRIX_HUB75_16ROW_MOD8SCAN ? 16 : 0) | \
-                                                     (x == SMARTMATRIX_HUB75_64ROW_MOD32SCAN ? 64 : 0))
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+    static volatile smRowCallback rowCallbacks[SMARTMATRIX_ROW_CALLBACKS];
+    static volatile smFrameCallback frameCallback;
+    static volatile bool callbackOverrun;
+#endif
 
-#define CONVERT_PANELTYPE_TO_MATRIXROWPAIROFFSET(x)   ((x == SMARTMATRIX_HUB75_32ROW_MOD16SCAN ? 16 : 0) | \
-                                                     (x == SMARTMATRIX_HUB75_16ROW_MOD8SCAN ? 8 : 0) | \
-                                                     (x == SMARTMATRIX_HUB75_64ROW_MOD32SCAN ? 32 : 0))
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+    static SM_Layer * staticLayerCacheOwner[SMARTMATRIX_STATIC_LAYER_CACHES];
+    static uint8_t staticLayerCacheValid[SMARTMATRIX_STATIC_LAYER_CACHES][(matrixHeight + 7) / 8];     // bit per row
+    static uint8_t staticLayerCacheOpaque[SMARTMATRIX_STATIC_LAYER_CACHES][(matrixHeight + 7) / 8];    // bit per row
+    static uint8_t staticLayerCacheCoverage[SMARTMATRIX_STATIC_LAYER_CACHES][matrixHeight][(matrixWidth + 7) / 8];
+    static refreshPixel staticLayerCache[SMARTMATRIX_STATIC_LAYER_CACHES][matrixHeight][matrixWidth];
+#endif
 
-#define CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(x)   ((x == SMARTMATRIX_HUB75_32ROW_MOD16SCAN ? 16 : 0) | \
-                                                     (x == SMARTMATRIX_HUB75_16ROW_MOD8SCAN ? 8 : 0) | \
-                                                     (x == SMARTMATRIX_HUB75_64ROW_MOD32SCAN ? 32 : 0))
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    // step 0 is the brightness the fade started from, fadeSteps is the target
+    static uint16_t fadeLuminances[SMARTMATRIX_BRIGHTNESS_FADE_STEPS + 1];                 // light output, out of 65535
+    static uint16_t fadeOnTimes[SMARTMATRIX_BRIGHTNESS_FADE_STEPS + 1][latchesPerRow];     // timer_oe for each block
+    static uint16_t timerLutMsbBlockTicks;
+    static uint8_t timerLutBrightness;                                                      // brightness on the display when not fading
+    static volatile bool fadeActive;
+    static uint8_t fadeTarget;
+    static uint8_t fadeSteps;
+    static uint8_t fadeStep;
+    static uint16_t fadeFrames;
+    static uint16_t fadeFrame;
+#endif
+
+#ifdef SMARTMATRIX_PREFETCH_ENABLED
+    static CircularBuffer prefetchQueue;
+    static refreshPixel prefetchBuffer[];   // SMARTMATRIX_PREFETCH_ROWS pairs of rows
+#endif
+};
 
 #define SMARTMATRIX_OPTIONS_NONE                    0
 #define SMARTMATRIX_OPTIONS_C_SHAPE_STACKING        (1 << 0)
@@ -152,10 +322,12 @@ private:
 
 // single matrixUpdateBlocks buffer is divided up to hold matrixUpdateBlocks, addressLUT, timerLUT to simplify user sketch code and reduce constructor parameters
 #define SMARTMATRIX_ALLOCATE_BUFFERS(matrix_name, width, height, pwm_depth, buffer_rows, panel_type, option_flags) \
-    static DMAMEM uint32_t matrixUpdateData[buffer_rows * (pwm_depth/COLOR_CHANNELS_PER_PIXEL / sizeof(uint32_t)) * ((((width * height) / CONVERT_PANELTYPE_TO_MATRIXPANELHEIGHT(panel_type)) * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES))]; \
+    static DMAMEM uint32_t matrixUpdateData[buffer_rows * (pwm_depth/COLOR_CHANNELS_PER_PIXEL / sizeof(uint32_t)) * ((((width * height) / (2 * CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(panel_type))) * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES * SMARTMATRIX_PARALLEL_CHAINS))]; \
     static DMAMEM uint8_t matrixUpdateBlocks[(sizeof(matrixUpdateBlock) * buffer_rows * pwm_depth/COLOR_CHANNELS_PER_PIXEL) + (sizeof(addresspair) * CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(panel_type)) + (sizeof(timerpair) * pwm_depth/COLOR_CHANNELS_PER_PIXEL) + sizeof(timerpair)]; \
     SmartMatrix3<pwm_depth, width, height, panel_type, option_flags> matrix_name(buffer_rows, matrixUpdateData, matrixUpdateBlocks)
 
+#include "MatrixCostModel.h"
+
 #define SMARTMATRIX_ALLOCATE_SCROLLING_LAYER(layer_name, width, height, storage_depth, scrolling_options) \
     typedef RGB_TYPE(storage_depth) SM_RGB;                                                                 \
     static uint8_t layer_name##Bitmap[width * (height / 8)];                                              \
@@ -171,6 +343,27 @@ private:
     static RGB_TYPE(storage_depth) backgroundBitmap[2*width*height];                                        \
     static SMLayerBackground<RGB_TYPE(storage_depth), background_options> layer_name(backgroundBitmap, width, height)  
 
+// width and height are the size of the screen, source_width and source_height the size of the image that's scaled up
+#define SMARTMATRIX_ALLOCATE_SCALED_LAYER(layer_name, width, height, source_width, source_height, storage_depth, scaled_options) \
+    typedef RGB_TYPE(storage_depth) SM_RGB;                                                                 \
+    static RGB_TYPE(storage_depth) layer_name##Bitmap[2*source_width*source_height];                        \
+    static int32_t layer_name##IndexTables[width + height];                                                 \
+    static SMLayerScaled<RGB_TYPE(storage_depth), scaled_options> layer_name(layer_name##Bitmap, source_width, source_height, layer_name##IndexTables, width, height)
+
+// canvas_width and canvas_height are the size of the logical canvas drawn to, map is a width * height table (see Layer_Remap.h)
+#define SMARTMATRIX_ALLOCATE_REMAP_LAYER(layer_name, width, height, canvas_width, canvas_height, storage_depth, map, remap_options) \
+    typedef RGB_TYPE(storage_depth) SM_RGB;                                                                 \
+    static RGB_TYPE(storage_depth) layer_name##Bitmap[2*canvas_width*canvas_height];                        \
+    static SMLayerRemap<RGB_TYPE(storage_depth), remap_options> layer_name(layer_name##Bitmap, canvas_width, canvas_height, map, width, height)
+
+// refresh driver, see MatrixDriver.h
+#ifdef SMARTMATRIX_LINUX_SIM
+    #include "MatrixDriver_LinuxSim.h"
+    typedef SMDriverLinuxSim SMDriver;
+#else
+    #include "MatrixDriver_Teensy3.h"
+    typedef SMDriverTeensy3 SMDriver;
+#endif
 
 #include "SmartMatrix_Impl.h"
 
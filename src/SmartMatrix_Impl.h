@@ -23,37 +23,35 @@
 
 #include "SmartMatrix3.h"
 #include "CircularBuffer.h"
-#include "DMAChannel.h"
-
-#define INLINE __attribute__( ( always_inline ) ) inline
 
 #define MATRIX_STACK_HEIGHT (matrixHeight / matrixPanelHeight)
-
-#define ROW_CALCULATION_ISR_PRIORITY   0xFE // 0xFF = lowest priority
-
-// hardware-specific definitions
-// prescale of 1 is F_BUS/2
-#define LATCH_TIMER_PRESCALE  0x01
-#define TIMER_FREQUENCY     (F_BUS/2)
+#define CHAIN_STACK_HEIGHT  (MATRIX_STACK_HEIGHT / SMARTMATRIX_PARALLEL_CHAINS)
+#define MATRIX_ROWS_PER_ADDRESS     CONVERT_PANELTYPE_TO_MATRIXROWSPERADDRESS(panelType)
+// pixels aren't shifted out in the order they're composited for panels that light more than one row per address in
+// each half, or with C-shape stacking
+#define PIXEL_REMAP_ENABLED ((MATRIX_ROWS_PER_ADDRESS > 1) || smPanelDescriptions[panelType].blockWidth || \
+                            (optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING))
+
+// timing in ticks of TIMER_FREQUENCY, defined by the driver
 #define NS_TO_TICKS(X)      (uint32_t)(TIMER_FREQUENCY * ((X) / 1000000000.0))
 #define LATCH_TIMER_PULSE_WIDTH_TICKS   NS_TO_TICKS(LATCH_TIMER_PULSE_WIDTH_NS)
 #define TICKS_PER_ROW   (TIMER_FREQUENCY/refreshRate/matrixRowsPerFrame)
+// ticks left over by TICKS_PER_ROW each second, spread over the rows one tick at a time by loadMatrixBuffers()
+#define ROWS_PER_SECOND         ((uint32_t)refreshRate * matrixRowsPerFrame)
+#define TICKS_PER_ROW_REMAINDER (TIMER_FREQUENCY % ROWS_PER_SECOND)
 #define IDEAL_MSB_BLOCK_TICKS     (TICKS_PER_ROW/2)
 #define MIN_BLOCK_PERIOD_NS (LATCH_TO_CLK_DELAY_NS + ((PANEL_32_PIXELDATA_TRANSFER_MAXIMUM_NS*PIXELS_PER_LATCH)/32))
 #define MIN_BLOCK_PERIOD_TICKS NS_TO_TICKS(MIN_BLOCK_PERIOD_NS)
-#define PIXELS_PER_LATCH    ((matrixWidth * matrixHeight) / matrixPanelHeight)
+// pixels composited for each row address in each half of the panels, across all chains
+#define PIXELS_PER_ROW      ((matrixWidth * matrixHeight) / (2 * CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(panelType)))
+// pixels shifted out to each chain per latch, the chains are shifted in parallel
+#define PIXELS_PER_LATCH    (PIXELS_PER_ROW / SMARTMATRIX_PARALLEL_CHAINS)
 
 // slower refresh rates require larger timer values - get the min refresh rate from the largest MSB value that will fit in the timer (round up)
-#define MIN_REFRESH_RATE    (((TIMER_FREQUENCY/65535)/16/2) + 1)
+// the MSB block is half a row, and rows take longer with fewer rows per frame
+#define MIN_REFRESH_RATE    ((TIMER_FREQUENCY / (65535UL * 2 * CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(panelType))) + 1)
 
-#define TIMER_REGISTERS_TO_UPDATE   2
-
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-    extern DMAChannel dmaOutputAddress;
-    extern DMAChannel dmaUpdateAddress;
-#endif
-extern DMAChannel dmaUpdateTimer;
-extern DMAChannel dmaClockOutData;
+#define MIN_DMA_BUFFER_ROWS         2
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 const int SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixPanelHeight = CONVERT_PANELTYPE_TO_MATRIXPANELHEIGHT(panelType);
@@ -61,6 +59,8 @@ template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char pan
 const int SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixRowPairOffset = CONVERT_PANELTYPE_TO_MATRIXROWPAIROFFSET(panelType);
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 const int SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixRowsPerFrame = CONVERT_PANELTYPE_TO_MATRIXROWSPERFRAME(panelType);
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::pixelRemap[PIXEL_REMAP_ENABLED ? PIXELS_PER_ROW : 1];
 
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
@@ -74,17 +74,27 @@ extern CircularBuffer dmaBuffer;
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>* SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::globalinstance;
 // dmaBufferNumRows = the size of the buffer that DMA pulls from to refresh the display
-// must be minimum 2 rows so one can be updated while the other is refreshed
+// must be minimum 2 rows (MIN_DMA_BUFFER_ROWS) so one can be updated while the other is refreshed
 // increase beyond two to give more time for the update routine to complete
 // (increase this number if non-DMA interrupts are causing display problems)
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferNumRows;
+// dmaBufferActiveRows = the number of rows actually filled ahead of DMA, from MIN_DMA_BUFFER_ROWS up to dmaBufferNumRows
+// can be changed at runtime, or adjusted automatically with setDmaBufferRowsAdaptive()
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
-uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferBytesPerPixel;
+volatile uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferActiveRows;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferRowsAdaptive = false;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile smDmaBufferRowsChange SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferRowsChangeReason = smDmaBufferRowsAllocated;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferBytesPerPixel;
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferBytesPerRow;
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::refreshRate = 120;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint32_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::rowTicksError;
 
 
 // todo: just use a single buffer for Blocks/LUT/Data?
@@ -113,6 +123,74 @@ bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::refreshRateChanged = true;
 
+// next row to be composited from the layers, runs ahead of the row being loaded into the DMA buffer when rows are prefetched
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+unsigned char SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::composeRow = 0;
+
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+smLayerProfile SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::layerProfiles[SMARTMATRIX_PROFILING_MAX_LAYERS];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+smProfileCounter SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::packingProfile;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+smCallbackProfile SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::callbackProfile;
+#endif
+
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeLuminances[SMARTMATRIX_BRIGHTNESS_FADE_STEPS + 1];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeOnTimes[SMARTMATRIX_BRIGHTNESS_FADE_STEPS + 1][latchesPerRow];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::timerLutMsbBlockTicks = 0;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::timerLutBrightness;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeActive = false;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeTarget;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeSteps;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeStep;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeFrames;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeFrame;
+#endif
+
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile smRowCallback SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::rowCallbacks[SMARTMATRIX_ROW_CALLBACKS];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile smFrameCallback SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::frameCallback = NULL;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::callbackOverrun = false;
+#endif
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::frameDirtyRows[(matrixHeight + 7) / 8];
+
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+SM_Layer * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::staticLayerCacheOwner[SMARTMATRIX_STATIC_LAYER_CACHES];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::staticLayerCacheValid[SMARTMATRIX_STATIC_LAYER_CACHES][(matrixHeight + 7) / 8];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::staticLayerCacheOpaque[SMARTMATRIX_STATIC_LAYER_CACHES][(matrixHeight + 7) / 8];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::staticLayerCacheCoverage[SMARTMATRIX_STATIC_LAYER_CACHES][matrixHeight][(matrixWidth + 7) / 8];
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+typename SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::refreshPixel SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::staticLayerCache[SMARTMATRIX_STATIC_LAYER_CACHES][matrixHeight][matrixWidth];
+#endif
+
+#ifdef SMARTMATRIX_PREFETCH_ENABLED
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+CircularBuffer SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::prefetchQueue;
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+typename SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::refreshPixel SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::prefetchBuffer[SMARTMATRIX_PREFETCH_ROWS * 2 * PIXELS_PER_ROW];
+#endif
+
 
 /*
   buffer contains:
@@ -138,24 +216,19 @@ bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 uint32_t * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateData;
 
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-#define ADDRESS_ARRAY_REGISTERS_TO_UPDATE   2
-
-// 2x uint32_t to match size and spacing of values it is updating: GPIOx_PSOR and GPIOx_PCOR are 32-bit and adjacent to each other
-typedef struct gpiopair {
-    uint32_t  gpio_psor;
-    uint32_t  gpio_pcor;
-} gpiopair;
-
-static gpiopair gpiosync;
-#endif
-
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::SmartMatrix3(uint8_t bufferrows, uint32_t * dataBuffer, uint8_t * blockBuffer) {
+    static_assert(((matrixHeight / CONVERT_PANELTYPE_TO_MATRIXPANELHEIGHT(panelType)) % SMARTMATRIX_PARALLEL_CHAINS) == 0,
+        "stacked panels must divide evenly between SMARTMATRIX_PARALLEL_CHAINS");
+    static_assert(!smPanelDescriptions[panelType].blockWidth || !(matrixWidth % smPanelDescriptions[panelType].blockWidth),
+        "matrixWidth must be a multiple of the panel's blockWidth");
+
     SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::globalinstance = this;
     dmaBufferNumRows = bufferrows;
-    dmaBufferBytesPerPixel = latchesPerRow * DMA_UPDATES_PER_CLOCK;
-    dmaBufferBytesPerRow = latchesPerRow * (PIXELS_PER_LATCH * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES);
+    dmaBufferActiveRows = bufferrows;
+    // each DMA transfer writes a byte to every chain
+    dmaBufferBytesPerPixel = latchesPerRow * DMA_UPDATES_PER_CLOCK * SMARTMATRIX_PARALLEL_CHAINS;
+    dmaBufferBytesPerRow = latchesPerRow * (PIXELS_PER_LATCH * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES) * SMARTMATRIX_PARALLEL_CHAINS;
 
     matrixUpdateData = dataBuffer;
     // single buffer is divided up to hold matrixUpdateBlocks, addressLUT, timerLUT to simplify user sketch code and reduce constructor parameters
@@ -172,18 +245,90 @@ SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::S
     timerPairIdle->timer_oe = MIN_BLOCK_PERIOD_TICKS;
 }
 
+// the layer functions edit the pending order with the row calculation held off, so the refresh code never copies a
+// half-changed list
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::addLayer(SM_Layer * newlayer) {
-    if(baseLayer) {
-        SM_Layer * templayer = baseLayer;
-        while(templayer->nextLayer)
-            templayer = templayer->nextLayer;
-        templayer->nextLayer = newlayer;
-    } else {
-        baseLayer = newlayer;
+    SMDriver::disableRowCalculation();
+    unlinkPendingLayer(newlayer);
+    SM_Layer ** link = &pendingBaseLayer;
+    while(*link)
+        link = &(*link)->pendingNextLayer;
+    *link = newlayer;
+    layerOrderChange = true;
+    SMDriver::enableRowCalculation();
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::insertLayer(SM_Layer * layer, SM_Layer * below) {
+    if(layer == below)
+        return;
+
+    SMDriver::disableRowCalculation();
+    unlinkPendingLayer(layer);
+    SM_Layer ** link = &pendingBaseLayer;
+    if(below) {
+        while(*link && *link != below)
+            link = &(*link)->pendingNextLayer;
+        // below isn't in the list, put layer on top
+        if(*link)
+            link = &below->pendingNextLayer;
+    }
+    layer->pendingNextLayer = *link;
+    *link = layer;
+    layerOrderChange = true;
+    SMDriver::enableRowCalculation();
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::removeLayer(SM_Layer * layer) {
+    SMDriver::disableRowCalculation();
+    unlinkPendingLayer(layer);
+    layerOrderChange = true;
+    SMDriver::enableRowCalculation();
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::unlinkPendingLayer(SM_Layer * layer) {
+    SM_Layer ** link = &pendingBaseLayer;
+    while(*link) {
+        if(*link == layer) {
+            *link = layer->pendingNextLayer;
+            layer->pendingNextLayer = NULL;
+            return;
+        }
+        link = &(*link)->pendingNextLayer;
     }
 }
 
+// called at the start of a frame: the refresh code only follows baseLayer/nextLayer, so copy the new order over them
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::applyLayerOrder(void) {
+    SM_Layer * templayer = globalinstance->pendingBaseLayer;
+    globalinstance->baseLayer = templayer;
+    while(templayer) {
+        // layers that were just added haven't been given the settings yet, setRotation() also marks all rows dirty
+        templayer->setRotation(rotation);
+        templayer->setRefreshRate(refreshRate);
+        templayer->nextLayer = templayer->pendingNextLayer;
+        templayer = templayer->nextLayer;
+    }
+    layerOrderChange = false;
+
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+    // free the caches of layers that were removed
+    int i;
+    for(i=0; i<SMARTMATRIX_STATIC_LAYER_CACHES; i++) {
+        for(templayer = globalinstance->baseLayer; templayer; templayer = templayer->nextLayer) {
+            if(templayer == staticLayerCacheOwner[i])
+                break;
+        }
+        if(!templayer)
+            staticLayerCacheOwner[i] = NULL;
+    }
+#endif
+}
+
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::countFPS(void) {
   static long loops = 0;
@@ -205,13 +350,27 @@ void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
 
 #define MAX_MATRIXCALCULATIONS_LOOPS_WITHOUT_EXIT  5
 
+// adaptive DMA buffer depth: a row is removed after this many frames where at least one more row than needed was always waiting
+#define DMA_BUFFER_ROWS_SHRINK_FRAMES   240
+
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixCalculations(bool initial) {
     static unsigned char currentRow = 0;
+    static unsigned char minRowsWaiting = 0xFF;
+    static uint16_t framesSinceDepthCheck = 0;
     unsigned char numLoopsWithoutExit = 0;
 
-    // only run the loop if there is free space, and fill the entire buffer before returning
-    while (!cbIsFull(&dmaBuffer)) {
+    // rows still waiting (including the one being shifted out) is a measure of how late this ISR is running
+    if(cbGetCount(&dmaBuffer) < minRowsWaiting)
+        minRowsWaiting = cbGetCount(&dmaBuffer);
+
+#ifdef SMARTMATRIX_TRACE_ENABLED
+    unsigned char rowsCalculated = 0;
+#endif
+    SM_TRACE(smTraceRowCalculationStart, cbGetCount(&dmaBuffer), 0);
+
+    // only run the loop if there is free space, and fill the active part of the buffer before returning
+    while (cbGetCount(&dmaBuffer) < dmaBufferActiveRows) {
         // check to see if the refresh rate is too high, and the application doesn't have time to run
         if(++numLoopsWithoutExit > MAX_MATRIXCALCULATIONS_LOOPS_WITHOUT_EXIT) {
 
@@ -221,81 +380,170 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
                 calculateTimerLut();
                 refreshRateLowered = true;
                 refreshRateChanged = true;
+                SM_TRACE(smTraceRefreshRateLowered, 0, refreshRate);
             }
 
             initial = false;
             numLoopsWithoutExit = 0;
         }
 
-        // do once-per-frame updates
-        if (!currentRow) {
-            if (rotationChange) {
-                SM_Layer * templayer = globalinstance->baseLayer;
-                while(templayer) {
-                    templayer->setRotation(rotation);
-                    templayer = templayer->nextLayer;
-                }
-                rotationChange = false;
-            }
-
-            SM_Layer * templayer = globalinstance->baseLayer;
-            while(templayer) {
-                if(refreshRateChanged) {
-                    templayer->setRefreshRate(refreshRate);
-                }
-                templayer->frameRefreshCallback();
-                templayer = templayer->nextLayer;
-            }
-            refreshRateChanged = false;
-            if (brightnessChange) {
-                calculateTimerLut();
-                brightnessChange = false;
-            }
-        }
-
-        // do once-per-line updates
-        // none right now
-
         // enqueue row
         SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers(currentRow);
         cbWrite(&dmaBuffer);
+#ifdef SMARTMATRIX_TRACE_ENABLED
+        rowsCalculated++;
+#endif
 
-        if (++currentRow >= matrixRowsPerFrame)
+        if (++currentRow >= matrixRowsPerFrame) {
             currentRow = 0;
 
+            // remove a row from the buffer if the spare rows weren't needed for a while
+            if(dmaBufferRowsAdaptive && ++framesSinceDepthCheck >= DMA_BUFFER_ROWS_SHRINK_FRAMES) {
+                if(minRowsWaiting >= 2 && dmaBufferActiveRows > MIN_DMA_BUFFER_ROWS)
+                    changeDmaBufferRows(dmaBufferActiveRows - 1, smDmaBufferRowsUnused);
+
+                minRowsWaiting = 0xFF;
+                framesSinceDepthCheck = 0;
+            }
+        }
+
         if(dmaBufferUnderrun) {
+            // add a row to the buffer if there's room, otherwise lower the refreshrate
+            if(dmaBufferRowsAdaptive && dmaBufferActiveRows < dmaBufferNumRows) {
+                changeDmaBufferRows(dmaBufferActiveRows + 1, smDmaBufferRowsUnderrun);
+                minRowsWaiting = 0xFF;
+                framesSinceDepthCheck = 0;
             // if refreshrate is too high, lower - minimum set to avoid overflowing timer at low refresh rates
-            if(refreshRate > MIN_REFRESH_RATE) {
+            } else if(refreshRate > MIN_REFRESH_RATE) {
                 refreshRate--;
                 calculateTimerLut();
                 refreshRateLowered = true;
                 refreshRateChanged = true;
+                SM_TRACE(smTraceRefreshRateLowered, 0, refreshRate);
             }
 
-            // stop timer
-            FTM1_SC = FTM_SC_CLKS(0) | FTM_SC_PS(LATCH_TIMER_PRESCALE);
-
-            // point DMA addresses to the next buffer
+            // point the driver at the next row and start shifting again
             int currentRow = cbGetNextRead(&dmaBuffer);
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-            dmaUpdateAddress.TCD->SADDR = &((matrixUpdateBlock*)SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateBlocks + (currentRow * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::latchesPerRow))->addressValues;
-#endif
-            dmaUpdateTimer.TCD->SADDR = &((matrixUpdateBlock*)SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateBlocks + (currentRow * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::latchesPerRow))->timerValues.timer_oe;
-            dmaClockOutData.TCD->SADDR = (uint8_t*)SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateData + (currentRow * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferBytesPerRow);
-
-            // enable channel-to-channel linking so data will be shifted out
-            dmaUpdateTimer.TCD->CSR &= ~(1 << 7);  // must clear DONE flag before enabling
-            dmaUpdateTimer.TCD->CSR |= (1 << 5);
-            // set timer increment back to read from matrixUpdateBlocks
-            dmaUpdateTimer.TCD->SLAST = sizeof(matrixUpdateBlock) - (TIMER_REGISTERS_TO_UPDATE * sizeof(uint16_t));
+            SMDriver::restartRow(getRowBlocks(currentRow), getRowData(currentRow));
 
             dmaBufferUnderrunSinceLastCheck = true;
             dmaBufferUnderrun = false;
 
-            // start timer again - next timer period is MIN_BLOCK_PERIOD_TICKS with OE disabled, period after that will be loaded from matrixUpdateBlock
-            FTM1_SC = FTM_SC_CLKS(1) | FTM_SC_PS(LATCH_TIMER_PRESCALE);
+            SM_TRACE(smTraceUnderrunRecovered, 0, refreshRate);
         }
     }
+
+    SM_TRACE(smTraceRowCalculationEnd, rowsCalculated, 0);
+}
+
+// composites the next row in refresh order from all layers, doing the once-per-frame updates first if the row starts a new frame
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::composeNextRow(refreshPixel tempRow0[], refreshPixel tempRow1[]) {
+    // do once-per-frame updates
+    if (!composeRow) {
+        SM_TRACE(smTraceFrameStart, 0, refreshRate);
+#ifdef SMARTMATRIX_FRAME_PACING_ENABLED
+        SMFramePacing::refreshFrameStarted();
+#endif
+
+        // before anything else that walks the layers
+        bool layersChanged = layerOrderChange;
+        if (layersChanged)
+            applyLayerOrder();
+
+        if (rotationChange) {
+            SM_TRACE(smTraceRotationChange, rotation, 0);
+            SM_Layer * templayer = globalinstance->baseLayer;
+            while(templayer) {
+                templayer->setRotation(rotation);
+                templayer = templayer->nextLayer;
+            }
+            rotationChange = false;
+        }
+
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+        // before the layers' callbacks, so changes it makes are seen by the whole frame
+        runFrameCallback();
+#endif
+
+        SM_Layer * templayer = globalinstance->baseLayer;
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+        uint8_t layerIndex = 0;
+#endif
+        while(templayer) {
+            if(refreshRateChanged) {
+                templayer->setRefreshRate(refreshRate);
+            }
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+            uint32_t layerStartTime = smProfilingTimestamp();
+#endif
+            templayer->updateVisibility();
+            // before the callback, which folds the brightness into the layer's LUT or colors
+            templayer->updateBrightness();
+            templayer->frameRefreshCallback();
+            // after the callback, which may have moved the layer's content
+            templayer->updateClip();
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+            if(layerIndex < SMARTMATRIX_PROFILING_MAX_LAYERS)
+                smProfileCounterAdd(&layerProfiles[layerIndex].frameRefreshCallback, smProfilingTimestamp() - layerStartTime);
+            layerIndex++;
+#endif
+            templayer = templayer->nextLayer;
+        }
+        refreshRateChanged = false;
+
+        // after the callbacks, which may have swapped buffers and marked rows dirty
+        updateDirtyRows();
+        // rows a removed layer covered change too
+        if (layersChanged)
+            memset(frameDirtyRows, 0xFF, sizeof(frameDirtyRows));
+
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+        if (fadeActive)
+            updateFade();
+#endif
+
+        if (brightnessChange) {
+            SM_TRACE(smTraceBrightnessChange, 0, dimmingFactor);
+            calculateTimerLut();
+            brightnessChange = false;
+        }
+    }
+
+    // do once-per-line updates
+    // none right now
+
+    // clear buffer to prevent garbage data showing through transparent layers
+    memset((void *)tempRow0, 0x00, sizeof(refreshPixel) * PIXELS_PER_ROW);
+    memset((void *)tempRow1, 0x00, sizeof(refreshPixel) * PIXELS_PER_ROW);
+
+    // get pixel data from layers
+    fillRowFromLayers(composeRow, tempRow0, tempRow1);
+
+    if (++composeRow >= matrixRowsPerFrame)
+        composeRow = 0;
+}
+
+// pixelRemap[i] is where the i-th pixel shifted out is in the composited rows: each section (row of panels) of
+// tempRow0/tempRow1 holds MATRIX_ROWS_PER_ADDRESS rows of matrixWidth pixels, in the order fillRowFromLayers() fills them
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::calculatePixelRemap(void) {
+    int i;
+
+    if(!PIXEL_REMAP_ENABLED)
+        return;
+
+    for(i=0; i<PIXELS_PER_ROW; i++) {
+        uint16_t section = i / (matrixWidth * MATRIX_ROWS_PER_ADDRESS);
+        uint8_t subRow;
+        uint16_t x = smPanelPixelPosition(smPanelDescriptions[panelType], matrixWidth, i % (matrixWidth * MATRIX_ROWS_PER_ADDRESS), &subRow);
+
+        // for upside down stacks, flip order
+        if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && !((section % CHAIN_STACK_HEIGHT) % 2))
+            x = matrixWidth - x - 1;
+
+        pixelRemap[i] = ((section * MATRIX_ROWS_PER_ADDRESS) + subRow) * matrixWidth + x;
+    }
 }
 
 #define MSB_BLOCK_TICKS_ADJUSTMENT_INCREMENT    10
@@ -307,8 +555,9 @@ void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
     uint16_t msbBlockTicks = IDEAL_MSB_BLOCK_TICKS + MSB_BLOCK_TICKS_ADJUSTMENT_INCREMENT;
 
     // start with ideal width of the MSB, and keep lowering until the width of all bits fits within TICKS_PER_ROW
+    // (the timer counts TIMER_PERIOD_EXTRA_TICKS more than timer_period for each block)
     do {
-        ticksUsed = 0;
+        ticksUsed = latchesPerRow * TIMER_PERIOD_EXTRA_TICKS;
         msbBlockTicks -= MSB_BLOCK_TICKS_ADJUSTMENT_INCREMENT;
         for (i = 0; i < latchesPerRow; i++) {
             uint16_t blockTicks = (msbBlockTicks >> (latchesPerRow - i - 1)) + LATCH_TIMER_PULSE_WIDTH_TICKS;
@@ -320,6 +569,9 @@ void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
         }
     } while (ticksUsed > TICKS_PER_ROW);
 
+    // the rows start over with a new remainder
+    rowTicksError = 0;
+
     for (i = 0; i < latchesPerRow; i++) {
         // set period and OE values for current block - going from smallest timer values to largest
         // order needs to be smallest to largest so the last update of the row has the largest time between
@@ -337,17 +589,27 @@ void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
             ontime += padding;
         }
 
-        // add extra padding once per latch to match refreshRate exactly?  Doesn't seem to make a big difference
-#if 0        
+        // pad the first (shortest) block with the display off so the row takes exactly TICKS_PER_ROW, keeping the
+        // refresh rate at refreshRate instead of running fast by the ticks the MSB adjustment left unused
         if(!i) {
-            uint16_t padding = TICKS_PER_ROW/2 - msbBlockTicks;
+            uint16_t padding = TICKS_PER_ROW - ticksUsed;
             period += padding;
             ontime += padding;
         }
-#endif
         timerLUT[i].timer_period = period;
         timerLUT[i].timer_oe = ontime;
     }
+
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    // the periods changed, so the fade's timer values need working out again, and the display stays at the current step
+    timerLutMsbBlockTicks = msbBlockTicks;
+    timerLutBrightness = dimmingMaximum - dimmingFactor;
+    if(fadeActive) {
+        calculateFadeTimerLuts();
+        for (i = 0; i < latchesPerRow; i++)
+            timerLUT[i].timer_oe = fadeOnTimes[fadeStep][i];
+    }
+#endif
 }
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
@@ -378,6 +640,9 @@ template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char pan
 volatile bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::brightnessChange = false;
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 volatile bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::rotationChange = true;
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+volatile bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::layerOrderChange = false;
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 rotationDegrees SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::rotation = rotation0;
 
@@ -389,8 +654,16 @@ int SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::setBrightness(uint8_t brightness) {
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    // stop a fade, without the row calculation ISR finishing it in between
+    SMDriver::disableRowCalculation();
+    fadeActive = false;
+#endif
     dimmingFactor = dimmingMaximum - brightness;
     brightnessChange = true;
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    SMDriver::enableRowCalculation();
+#endif
 }
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
@@ -403,11 +676,66 @@ void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
     calculateTimerLut();
 }
 
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::changeDmaBufferRows(uint8_t rows, smDmaBufferRowsChange reason) {
+    if(rows < MIN_DMA_BUFFER_ROWS)
+        rows = MIN_DMA_BUFFER_ROWS;
+    if(rows > dmaBufferNumRows)
+        rows = dmaBufferNumRows;
+
+    // shrinking takes effect as DMA drains the extra rows, growing when the row calculation ISR next runs
+    dmaBufferActiveRows = rows;
+    dmaBufferRowsChangeReason = reason;
+    SM_TRACE(smTraceDmaBufferRowsChange, rows, reason);
+}
+
+// use fewer rows than allocated, minimum is MIN_DMA_BUFFER_ROWS
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::setDmaBufferRows(uint8_t rows) {
+    changeDmaBufferRows(rows, smDmaBufferRowsUser);
+}
+
+// when enabled, the number of rows in use shrinks while rows are to spare, and grows after an underrun before the refresh rate is lowered
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::setDmaBufferRowsAdaptive(bool enabled) {
+    dmaBufferRowsAdaptive = enabled;
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getDmaBufferRows(void) {
+    return dmaBufferActiveRows;
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+smDmaBufferRowsChange SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getDmaBufferRowsChangeReason(void) {
+    return dmaBufferRowsChangeReason;
+}
+
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getRefreshRate(void) {
     return refreshRate;
 }
 
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::isRowDirty(uint16_t hardwareY) {
+    if(hardwareY >= matrixHeight)
+        return false;
+
+    return frameDirtyRows[hardwareY/8] & (0x80 >> (hardwareY % 8));
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint16_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getDirtyRowCount(void) {
+    uint16_t count = 0;
+    int i;
+
+    for(i=0; i<matrixHeight; i++) {
+        if(isRowDirty(i))
+            count++;
+    }
+    return count;
+}
+
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getdmaBufferUnderrunFlag(void) {
     if(dmaBufferUnderrunSinceLastCheck) {
@@ -426,10 +754,64 @@ bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
     return false;
 }
 
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getLayerProfile(uint8_t layerIndex, smLayerProfile * profile) {
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    if(layerIndex >= SMARTMATRIX_PROFILING_MAX_LAYERS)
+        return false;
+
+    // copy with interrupts disabled so the counters are consistent with each other
+    noInterrupts();
+    *profile = layerProfiles[layerIndex];
+    interrupts();
+    return true;
+#else
+    return false;
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getPackingProfile(smProfileCounter * profile) {
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    noInterrupts();
+    *profile = packingProfile;
+    interrupts();
+    return true;
+#else
+    return false;
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getCallbackProfile(smCallbackProfile * profile) {
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    noInterrupts();
+    *profile = callbackProfile;
+    interrupts();
+    return true;
+#else
+    return false;
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::resetProfiles(void) {
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    noInterrupts();
+    memset(layerProfiles, 0x00, sizeof(layerProfiles));
+    memset(&packingProfile, 0x00, sizeof(packingProfile));
+    memset(&callbackProfile, 0x00, sizeof(callbackProfile));
+    interrupts();
+#endif
+}
+
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::begin(void)
 {
     cbInit(&dmaBuffer, dmaBufferNumRows);
+#ifdef SMARTMATRIX_PREFETCH_ENABLED
+    cbInit(&prefetchQueue, SMARTMATRIX_PREFETCH_ROWS);
+#endif
 
 #ifndef ADDX_UPDATE_ON_DATA_PINS
     int i;
@@ -454,266 +836,396 @@ void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlag
     }
 #endif
 
+#if defined(SMARTMATRIX_PROFILING_ENABLED) || defined(SMARTMATRIX_TRACE_ENABLED) || defined(SMARTMATRIX_ROW_CALLBACKS_ENABLED)
+    smProfilingBegin();
+#endif
+
     // fill timerLUT
     calculateTimerLut();
+    calculatePixelRemap();
 
     // completely fill buffer with data before enabling DMA
     matrixCalculations(true);
 
-    // setup debug output
-#ifdef DEBUG_PINS_ENABLED
-    pinMode(DEBUG_PIN_1, OUTPUT);
-    digitalWriteFast(DEBUG_PIN_1, HIGH); // oscilloscope trigger
-    digitalWriteFast(DEBUG_PIN_1, LOW);
-    pinMode(DEBUG_PIN_2, OUTPUT);
-    digitalWriteFast(DEBUG_PIN_2, HIGH); // oscilloscope trigger
-    digitalWriteFast(DEBUG_PIN_2, LOW);
-    pinMode(DEBUG_PIN_3, OUTPUT);
-    digitalWriteFast(DEBUG_PIN_3, HIGH); // oscilloscope trigger
-    digitalWriteFast(DEBUG_PIN_3, LOW);
-#endif
+    smDriverConfig config;
+    config.firstBlocks = getRowBlocks(cbGetNextRead(&dmaBuffer));
+    config.firstData = getRowData(cbGetNextRead(&dmaBuffer));
+    config.latchesPerRow = latchesPerRow;
+    config.bytesPerLatch = PIXELS_PER_LATCH * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES;
+    config.parallelChains = SMARTMATRIX_PARALLEL_CHAINS;
+    config.initialPeriod = IDEAL_MSB_BLOCK_TICKS;
+    config.latchPulseTicks = LATCH_TIMER_PULSE_WIDTH_TICKS;
+    config.rowShiftCompleteISR = rowShiftCompleteISR<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>;
+    config.rowCalculationISR = rowCalculationISR<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>;
+    config.matrixWidth = matrixWidth;
+    config.matrixHeight = matrixHeight;
+    config.panelHeight = matrixPanelHeight;
+    config.rowPairOffset = matrixRowPairOffset;
+    config.rowsPerFrame = matrixRowsPerFrame;
+    config.panel = smPanelDescriptions[panelType];
+    config.optionFlags = optionFlags;
+
+    // start refreshing
+    SMDriver::begin(&config);
+}
 
-    // configure the 7 output pins (one pin is left as input, though it can't be used as GPIO output)
-    pinMode(GPIO_PIN_CLK_TEENSY_PIN, OUTPUT);
-    pinMode(GPIO_PIN_B0_TEENSY_PIN, OUTPUT);
-    pinMode(GPIO_PIN_R0_TEENSY_PIN, OUTPUT);
-    pinMode(GPIO_PIN_R1_TEENSY_PIN, OUTPUT);
-    pinMode(GPIO_PIN_G0_TEENSY_PIN, OUTPUT);
-    pinMode(GPIO_PIN_G1_TEENSY_PIN, OUTPUT);
-    pinMode(GPIO_PIN_B1_TEENSY_PIN, OUTPUT);
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE matrixUpdateBlock * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getRowBlocks(unsigned char bufferRow) {
+    return matrixUpdateBlocks + (bufferRow * latchesPerRow);
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE uint8_t * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getRowData(unsigned char bufferRow) {
+    return (uint8_t*)matrixUpdateData + (bufferRow * dmaBufferBytesPerRow);
+}
+
+// copy a word of packed data (four bitplanes of one pixel, one per byte) to the DMA buffer as a pair, one with clock set low, next with clock set high
+// pixel counts across all chains
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::storePixelWord(unsigned char freeRowBuffer, uint16_t pixel, uint8_t word, uint32_t data, uint32_t clock) {
+#if SMARTMATRIX_PARALLEL_CHAINS > 1
+    // the chains' bytes are interleaved so each DMA transfer writes the same bitplane to every chain
+    uint8_t * byteptr = getRowData(freeRowBuffer) + ((pixel % PIXELS_PER_LATCH) * dmaBufferBytesPerPixel) +
+        (word * sizeof(uint32_t) * SMARTMATRIX_PARALLEL_CHAINS) + (pixel / PIXELS_PER_LATCH);
+    int i;
 
-#ifdef ADDX_TEENSY_PIN_0
-    // configure the address pins
-    pinMode(ADDX_TEENSY_PIN_0, OUTPUT);
+    for(i=0; i<(int)sizeof(uint32_t); i++) {
+        byteptr[i * SMARTMATRIX_PARALLEL_CHAINS] = data >> (i * 8);
+        byteptr[(latchesPerRow + i) * SMARTMATRIX_PARALLEL_CHAINS] = (data | clock) >> (i * 8);
+    }
+#else
+    uint32_t * tempptr = (uint32_t*)getRowData(freeRowBuffer) + ((pixel*dmaBufferBytesPerPixel)/sizeof(uint32_t)) + word;
+    *tempptr = data;
+    *(tempptr + latchesPerRow/sizeof(uint32_t)) = data | clock;
 #endif
-#ifdef ADDX_TEENSY_PIN_1
-    pinMode(ADDX_TEENSY_PIN_1, OUTPUT);
+}
+
+// copy the row address (repeated in each byte of data) to the bytes following the pixel data, for every bitplane and chain
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::storeAddressWords(unsigned char freeRowBuffer, uint32_t data) {
+#if SMARTMATRIX_PARALLEL_CHAINS > 1
+    memset(getRowData(freeRowBuffer) + (PIXELS_PER_LATCH * dmaBufferBytesPerPixel), data & 0xFF, latchesPerRow * SMARTMATRIX_PARALLEL_CHAINS);
+#else
+    uint32_t * tempptr = (uint32_t*)getRowData(freeRowBuffer) + ((PIXELS_PER_LATCH*dmaBufferBytesPerPixel)/sizeof(uint32_t));
+    int i;
+
+    for(i=0; i<latchesPerRow/(int)sizeof(uint32_t); i++)
+        tempptr[i] = data;
 #endif
-#ifdef ADDX_TEENSY_PIN_2
-    pinMode(ADDX_TEENSY_PIN_2, OUTPUT);
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fillLayerRow(SM_Layer * layer, uint16_t hardwareY, refreshPixel refreshRow[]) {
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+    if(layer->isStatic() && fillRowFromCache(layer, hardwareY, refreshRow))
+        return;
 #endif
-#ifdef ADDX_TEENSY_PIN_3
-    pinMode(ADDX_TEENSY_PIN_3, OUTPUT);
+    layer->fillRefreshRow(hardwareY, refreshRow);
+}
+
+// called once per frame: collects the rows each layer changed, and drops those rows from the layer's cache
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::updateDirtyRows(void) {
+    uint8_t layerDirtyRows[(matrixHeight + 7) / 8];
+    int i;
+
+    memset(frameDirtyRows, 0x00, sizeof(frameDirtyRows));
+
+    SM_Layer * templayer = globalinstance->baseLayer;
+    while(templayer) {
+        memset(layerDirtyRows, 0x00, sizeof(layerDirtyRows));
+        if(templayer->takeDirtyRows(layerDirtyRows, matrixHeight)) {
+            for(i=0; i<(int)sizeof(frameDirtyRows); i++)
+                frameDirtyRows[i] |= layerDirtyRows[i];
+        }
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+        updateStaticLayerCache(templayer, layerDirtyRows);
 #endif
+        templayer = templayer->nextLayer;
+    }
+}
 
-    // setup FTM1
-    FTM1_SC = 0;
-    FTM1_CNT = 0;
-    FTM1_MOD = IDEAL_MSB_BLOCK_TICKS;
+#ifdef SMARTMATRIX_STATIC_LAYER_CACHE_ENABLED
+// gives a static layer a cache if one is free, frees the cache of a layer that isn't static anymore, and drops dirty rows from the cache
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::updateStaticLayerCache(SM_Layer * layer, const uint8_t layerDirtyRows[]) {
+    int i, j;
+    int freeCache = -1;
+
+    for(i=0; i<SMARTMATRIX_STATIC_LAYER_CACHES; i++) {
+        if(staticLayerCacheOwner[i] == layer)
+            break;
+        if(!staticLayerCacheOwner[i] && freeCache < 0)
+            freeCache = i;
+    }
+
+    if(!layer->isStatic()) {
+        if(i < SMARTMATRIX_STATIC_LAYER_CACHES)
+            staticLayerCacheOwner[i] = NULL;
+        return;
+    }
 
-    // setup FTM1 compares:
-    // latch pulse width set based on max time to update address pins
-    FTM1_C0V = LATCH_TIMER_PULSE_WIDTH_TICKS;
-    // output OE signal - set to max at first to disable OE
-    FTM1_C1V = IDEAL_MSB_BLOCK_TICKS;
+    if(i == SMARTMATRIX_STATIC_LAYER_CACHES) {
+        if(freeCache < 0)
+            return;
 
-    // setup PWM outputs
-    ENABLE_LATCH_PWM_OUTPUT();
-    ENABLE_OE_PWM_OUTPUT();
+        // new static layer, cache rows as they're refreshed
+        i = freeCache;
+        staticLayerCacheOwner[i] = layer;
+        memset(staticLayerCacheValid[i], 0x00, sizeof(staticLayerCacheValid[i]));
+    }
+
+    // dirty rows are filled again the next time they're refreshed, the rest are reused
+    for(j=0; j<(int)sizeof(staticLayerCacheValid[i]); j++)
+        staticLayerCacheValid[i][j] &= ~layerDirtyRows[j];
+}
 
-    // setup GPIO interrupts
-    ENABLE_LATCH_RISING_EDGE_GPIO_INT();
-    ENABLE_LATCH_FALLING_EDGE_GPIO_INT();
+// returns false if the layer doesn't have a cache, otherwise copies the layer's cached pixels to refreshRow, filling the cache first if needed
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fillRowFromCache(SM_Layer * layer, uint16_t hardwareY, refreshPixel refreshRow[]) {
+    int cache, i;
 
+    for(cache=0; cache<SMARTMATRIX_STATIC_LAYER_CACHES; cache++) {
+        if(staticLayerCacheOwner[cache] == layer)
+            break;
+    }
+    if(cache == SMARTMATRIX_STATIC_LAYER_CACHES)
+        return false;
+
+    refreshPixel * cachedRow = staticLayerCache[cache][hardwareY];
+    uint8_t * coverage = staticLayerCacheCoverage[cache][hardwareY];
+    uint8_t rowBitmask = 0x80 >> (hardwareY % 8);
+
+    if(!(staticLayerCacheValid[cache][hardwareY/8] & rowBitmask)) {
+        // static to avoid putting large buffer on the stack
+        static refreshPixel coverageRow[matrixWidth];
+        bool opaque = true;
+
+        // layers only write their opaque pixels: fill over black and over white, pixels that match were written by the layer
+        memset((void *)cachedRow, 0x00, sizeof(refreshPixel) * matrixWidth);
+        memset((void *)coverageRow, 0xFF, sizeof(coverageRow));
+        layer->fillRefreshRow(hardwareY, cachedRow);
+        layer->fillRefreshRow(hardwareY, coverageRow);
+
+        memset(coverage, 0x00, (matrixWidth + 7) / 8);
+        for(i=0; i<matrixWidth; i++) {
+            if(cachedRow[i].red == coverageRow[i].red && cachedRow[i].green == coverageRow[i].green && cachedRow[i].blue == coverageRow[i].blue)
+                coverage[i/8] |= 0x80 >> (i % 8);
+            else
+                opaque = false;
+        }
 
-    // enable clocks to the DMA controller and DMAMUX
-    SIM_SCGC7 |= SIM_SCGC7_DMA;
-    SIM_SCGC6 |= SIM_SCGC6_DMAMUX;
+        if(opaque)
+            staticLayerCacheOpaque[cache][hardwareY/8] |= rowBitmask;
+        else
+            staticLayerCacheOpaque[cache][hardwareY/8] &= ~rowBitmask;
+        staticLayerCacheValid[cache][hardwareY/8] |= rowBitmask;
+    }
 
-    // enable minor loop mapping so addresses can get reset after minor loops
-    DMA_CR |= DMA_CR_EMLM;
+    if(staticLayerCacheOpaque[cache][hardwareY/8] & rowBitmask) {
+        memcpy(refreshRow, cachedRow, sizeof(refreshPixel) * matrixWidth);
+        return true;
+    }
 
-    // allocate all DMA channels up front so channels can link to each other
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-    dmaOutputAddress.begin(false);
-    dmaUpdateAddress.begin(false);
+    for(i=0; i<matrixWidth; i++) {
+        // skip groups of 8 transparent pixels
+        if(!coverage[i/8]) {
+            i |= 0x07;
+            continue;
+        }
+        if(coverage[i/8] & (0x80 >> (i % 8)))
+            refreshRow[i] = cachedRow[i];
+    }
+    return true;
+}
 #endif
-    dmaUpdateTimer.begin(false);
-    dmaClockOutData.begin(false);
 
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-    // dmaOutputAddress - on latch rising edge, read address from fixed address temporary buffer, and output address on GPIO
-    // using combo of writes to set+clear registers, to only modify the address pins and not other GPIO pins
-    // address temporary buffer is refreshed before each DMA trigger (by DMA channel dmaUpdateAddress)
-    // only use single major loop, never disable channel
-    dmaOutputAddress.source(gpiosync.gpio_pcor);
-    dmaOutputAddress.TCD->SOFF = (int)&gpiosync.gpio_psor - (int)&gpiosync.gpio_pcor;
-    dmaOutputAddress.TCD->SLAST = (ADDRESS_ARRAY_REGISTERS_TO_UPDATE * ((int)&ADDX_GPIO_CLEAR_REGISTER - (int)&ADDX_GPIO_SET_REGISTER));
-    dmaOutputAddress.TCD->ATTR = DMA_TCD_ATTR_SSIZE(2) | DMA_TCD_ATTR_DSIZE(2);
-    // Destination Minor Loop Offset Enabled - transfer appropriate number of bytes per minor loop, and put DADDR back to original value when minor loop is complete
-    // Source Minor Loop Offset Enabled - source buffer is same size and offset as destination so values reset after each minor loop
-    dmaOutputAddress.TCD->NBYTES_MLOFFYES = DMA_TCD_NBYTES_SMLOE | DMA_TCD_NBYTES_DMLOE |
-                               ((ADDRESS_ARRAY_REGISTERS_TO_UPDATE * ((int)&ADDX_GPIO_CLEAR_REGISTER - (int)&ADDX_GPIO_SET_REGISTER)) << 10) |
-                               (ADDRESS_ARRAY_REGISTERS_TO_UPDATE * sizeof(gpiosync.gpio_psor));
-    // start on higher value of two registers, and make offset decrement to avoid negative number in NBYTES_MLOFFYES (TODO: can switch order by masking negative offset)
-    dmaOutputAddress.TCD->DADDR = &ADDX_GPIO_CLEAR_REGISTER;
-    // update destination address so the second update per minor loop is ADDX_GPIO_SET_REGISTER
-    dmaOutputAddress.TCD->DOFF = (int)&ADDX_GPIO_SET_REGISTER - (int)&ADDX_GPIO_CLEAR_REGISTER;
-    dmaOutputAddress.TCD->DLASTSGA = (ADDRESS_ARRAY_REGISTERS_TO_UPDATE * ((int)&ADDX_GPIO_CLEAR_REGISTER - (int)&ADDX_GPIO_SET_REGISTER));
-    // single major loop
-    dmaOutputAddress.TCD->CITER_ELINKNO = 1;
-    dmaOutputAddress.TCD->BITER_ELINKNO = 1;
-    // link channel dmaUpdateAddress, enable major channel-to-channel linking, don't clear enable on major loop complete
-    dmaOutputAddress.TCD->CSR = (dmaUpdateAddress.channel << 8) | (1 << 5);
-    dmaOutputAddress.triggerAtHardwareEvent(DMAMUX_SOURCE_LATCH_RISING_EDGE);
-
-    // dmaUpdateAddress - copy address values from current position in array to buffer to temporarily hold row values for the next timer cycle
-    // only use single major loop, never disable channel
-    dmaUpdateAddress.TCD->SADDR = &((matrixUpdateBlock*)matrixUpdateBlocks)->addressValues;
-    dmaUpdateAddress.TCD->SOFF = sizeof(uint16_t);
-    dmaUpdateAddress.TCD->SLAST = sizeof(matrixUpdateBlock) - (ADDRESS_ARRAY_REGISTERS_TO_UPDATE * sizeof(uint16_t));
-    dmaUpdateAddress.TCD->ATTR = DMA_TCD_ATTR_SSIZE(1) | DMA_TCD_ATTR_DSIZE(1);
-    // 16-bit = 2 bytes transferred
-    // transfer two 16-bit values, reset destination address back after each minor loop
-    dmaUpdateAddress.TCD->NBYTES_MLOFFNO = (ADDRESS_ARRAY_REGISTERS_TO_UPDATE * sizeof(uint16_t));
-    // start with the register that's the highest location in memory and make offset decrement to avoid negative number in NBYTES_MLOFFYES register (TODO: can switch order by masking negative offset)
-    dmaUpdateAddress.TCD->DADDR = &gpiosync.gpio_pcor;
-    dmaUpdateAddress.TCD->DOFF = (int)&gpiosync.gpio_psor - (int)&gpiosync.gpio_pcor;
-    dmaUpdateAddress.TCD->DLASTSGA = (ADDRESS_ARRAY_REGISTERS_TO_UPDATE * ((int)&gpiosync.gpio_pcor - (int)&gpiosync.gpio_psor));
-    // no minor loop linking, single major loop, single minor loop, don't clear enable after major loop complete
-    dmaUpdateAddress.TCD->CITER_ELINKNO = 1;
-    dmaUpdateAddress.TCD->BITER_ELINKNO = 1;
-    dmaUpdateAddress.TCD->CSR = 0;
-#endif
-
-    // dmaUpdateTimer - on latch falling edge, load FTM1_CV1 and FTM1_MOD with with next values from current block
-    // only use single major loop, never disable channel
-    // link to dmaClockOutData channel when complete
-    dmaUpdateTimer.TCD->SADDR = &((matrixUpdateBlock*)matrixUpdateBlocks)->timerValues.timer_oe;
-    dmaUpdateTimer.TCD->SOFF = sizeof(uint16_t);
-    dmaUpdateTimer.TCD->SLAST = sizeof(matrixUpdateBlock) - (TIMER_REGISTERS_TO_UPDATE * sizeof(uint16_t));
-    dmaUpdateTimer.TCD->ATTR = DMA_TCD_ATTR_SSIZE(1) | DMA_TCD_ATTR_DSIZE(1);
-    // 16-bit = 2 bytes transferred
-    dmaUpdateTimer.TCD->NBYTES_MLOFFNO = TIMER_REGISTERS_TO_UPDATE * sizeof(uint16_t);
-    dmaUpdateTimer.TCD->DADDR = &FTM1_C1V;
-    dmaUpdateTimer.TCD->DOFF = (int)&FTM1_MOD - (int)&FTM1_C1V;
-    dmaUpdateTimer.TCD->DLASTSGA = TIMER_REGISTERS_TO_UPDATE * ((int)&FTM1_C1V - (int)&FTM1_MOD);
-    // no minor loop linking, single major loop
-    dmaUpdateTimer.TCD->CITER_ELINKNO = 1;
-    dmaUpdateTimer.TCD->BITER_ELINKNO = 1;
-    // link dmaClockOutData channel, enable major channel-to-channel linking, don't clear enable after major loop complete
-    dmaUpdateTimer.TCD->CSR = (dmaClockOutData.channel << 8) | (1 << 5);
-    dmaUpdateTimer.triggerAtHardwareEvent(DMAMUX_SOURCE_LATCH_FALLING_EDGE);
-
-#define DMA_TCD_MLOFF_MASK  (0x3FFFFC00)
-
-    // dmaClockOutData - repeatedly load gpio_array into GPIOD_PDOR, stop and int on major loop complete
-    dmaClockOutData.TCD->SADDR = matrixUpdateData;
-    dmaClockOutData.TCD->SOFF = latchesPerRow;
-    // SADDR will get updated by ISR, no need to set SLAST
-    dmaClockOutData.TCD->SLAST = 0;
-    dmaClockOutData.TCD->ATTR = DMA_TCD_ATTR_SSIZE(0) | DMA_TCD_ATTR_DSIZE(0);
-    // after each minor loop, set source to point back to the beginning of this set of data,
-    // but advance by 1 byte to get the next significant bits data
-    dmaClockOutData.TCD->NBYTES_MLOFFYES = DMA_TCD_NBYTES_SMLOE |
-                               (((1 - (latchesPerRow * (PIXELS_PER_LATCH * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES))) << 10) & DMA_TCD_MLOFF_MASK) |
-                               (PIXELS_PER_LATCH * DMA_UPDATES_PER_CLOCK + ADDX_UPDATE_BEFORE_LATCH_BYTES);
-    dmaClockOutData.TCD->DADDR = &GPIOD_PDOR;
-    dmaClockOutData.TCD->DOFF = 0;
-    dmaClockOutData.TCD->DLASTSGA = 0;
-    dmaClockOutData.TCD->CITER_ELINKNO = latchesPerRow;
-    dmaClockOutData.TCD->BITER_ELINKNO = latchesPerRow;
-    // int after major loop is complete
-    dmaClockOutData.TCD->CSR = DMA_TCD_CSR_INTMAJOR;
-    
-    // for debugging - enable bandwidth control (space out GPIO updates so they can be seen easier on a low-bandwidth logic analyzer)
-    // enable for now, until DMA sharing complications (brought to light by Teensy 3.6 SDIO) can be worked out - use bandwidth control to space out our DMA access and allow SD reads to not slow down shifting to the matrix
-    // also enable for now, until it can be selectively enabled for higher clock speeds (140MHz+) where the data rate is too high for the panel
-    dmaClockOutData.TCD->CSR |= (0x02 << 14);
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fillRowFromLayers(unsigned char currentRow, refreshPixel tempRow0[], refreshPixel tempRow1[]) {
+    const int numRows = 2 * MATRIX_STACK_HEIGHT * MATRIX_ROWS_PER_ADDRESS;
+    uint16_t rowY[numRows];
+    refreshPixel * rowPixels[numRows];
+    int i;
 
-    // enable a done interrupt when all DMA operations are complete
-    dmaClockOutData.attachInterrupt(rowShiftCompleteISR<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>);
+    // work out which hardware row goes in each part of tempRow0 and tempRow1
+    // each is MATRIX_STACK_HEIGHT sections, in the order the stacked panels are chained
+    // each section is MATRIX_ROWS_PER_ADDRESS rows of matrixWidth pixels, the rows lit by the address matrixRowsPerFrame apart
+    // with parallel chains, each chain drives CHAIN_STACK_HEIGHT panels starting chainY rows down the display
+    for(i=0; i<MATRIX_STACK_HEIGHT * MATRIX_ROWS_PER_ADDRESS; i++) {
+        int section = (i / MATRIX_ROWS_PER_ADDRESS) % CHAIN_STACK_HEIGHT;
+        int chainY = ((i / MATRIX_ROWS_PER_ADDRESS) / CHAIN_STACK_HEIGHT) * CHAIN_STACK_HEIGHT * matrixPanelHeight;
+        // upside down panels light the rows in the opposite order
+        int subRowY = (i % MATRIX_ROWS_PER_ADDRESS) * matrixRowsPerFrame;
+        int flippedSubRowY = (MATRIX_ROWS_PER_ADDRESS - (i % MATRIX_ROWS_PER_ADDRESS) - 1) * matrixRowsPerFrame;
+
+        rowPixels[2*i] = &tempRow0[i*matrixWidth];
+        rowPixels[2*i + 1] = &tempRow1[i*matrixWidth];
+
+        // Z-shape, bottom to top
+        if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
+            (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
+            // fill data from bottom to top, so bottom panel is the one closest to Teensy
+            rowY[2*i] = currentRow + (CHAIN_STACK_HEIGHT-section-1)*matrixPanelHeight + subRowY + chainY;
+            rowY[2*i + 1] = currentRow + matrixRowPairOffset + (CHAIN_STACK_HEIGHT-section-1)*matrixPanelHeight + subRowY + chainY;
+        // Z-shape, top to bottom
+        } else if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
+            !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
+            // fill data from top to bottom, so top panel is the one closest to Teensy
+            rowY[2*i] = currentRow + section*matrixPanelHeight + subRowY + chainY;
+            rowY[2*i + 1] = currentRow + matrixRowPairOffset + section*matrixPanelHeight + subRowY + chainY;
+        // C-shape, bottom to top
+        } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
+            (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
+            // alternate direction of filling (or loading) for each matrixwidth
+            // swap row order from top to bottom for each stack (tempRow1 filled with top half of panel, tempRow0 filled with bottom half)
+            if((CHAIN_STACK_HEIGHT-section+1)%2) {
+                rowY[2*i] = (matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + section*matrixPanelHeight + flippedSubRowY + chainY;
+                rowY[2*i + 1] = (matrixRowsPerFrame-currentRow-1) + section*matrixPanelHeight + flippedSubRowY + chainY;
+            } else {
+                rowY[2*i] = currentRow + section*matrixPanelHeight + subRowY + chainY;
+                rowY[2*i + 1] = currentRow + matrixRowPairOffset + section*matrixPanelHeight + subRowY + chainY;
+            }
+        // C-shape, top to bottom
+        } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && 
+            !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
+            if((CHAIN_STACK_HEIGHT-section)%2) {
+                rowY[2*i] = currentRow + (CHAIN_STACK_HEIGHT-section-1)*matrixPanelHeight + subRowY + chainY;
+                rowY[2*i + 1] = currentRow + matrixRowPairOffset + (CHAIN_STACK_HEIGHT-section-1)*matrixPanelHeight + subRowY + chainY;
+            } else {
+                rowY[2*i] = (matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (CHAIN_STACK_HEIGHT-section-1)*matrixPanelHeight + flippedSubRowY + chainY;
+                rowY[2*i + 1] = (matrixRowsPerFrame-currentRow-1) + (CHAIN_STACK_HEIGHT-section-1)*matrixPanelHeight + flippedSubRowY + chainY;
+            }
+        }
+    }
 
-    // enable additional dma interrupt used as software interrupt
-    NVIC_SET_PRIORITY(IRQ_DMA_CH0 + dmaUpdateTimer.channel, ROW_CALCULATION_ISR_PRIORITY);
-    dmaUpdateTimer.attachInterrupt(rowCalculationISR<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>);
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    // all the rows a layer fills for this address are counted as one sample
+    uint32_t layerTicks[SMARTMATRIX_PROFILING_MAX_LAYERS] = {0};
+    uint8_t numLayers = 0;
+#endif
 
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-    dmaOutputAddress.enable();
-    dmaUpdateAddress.enable();
+    // rows are filled one at a time by all the layers, so a row callback can change the layers' parameters in between
+    for(i=0; i<numRows; i++) {
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+        runRowCallbacks(rowY[i]);
 #endif
-    dmaUpdateTimer.enable();
-    dmaClockOutData.enable();
 
-    // at the end after everything is set up: enable timer from system clock, with appropriate prescale
-    FTM1_SC = FTM_SC_CLKS(1) | FTM_SC_PS(LATCH_TIMER_PRESCALE);
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+        uint8_t layerIndex = 0;
+#endif
+        SM_Layer * templayer = globalinstance->baseLayer;
+        while(templayer) {
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+            uint32_t layerStartTime = smProfilingTimestamp();
+#endif
+            // rows outside the layer's clip rectangle aren't touched
+            if(templayer->isVisible() && templayer->coversRow(rowY[i]))
+                fillLayerRow(templayer, rowY[i], rowPixels[i]);
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+            if(layerIndex < SMARTMATRIX_PROFILING_MAX_LAYERS)
+                layerTicks[layerIndex] += smProfilingTimestamp() - layerStartTime;
+            layerIndex++;
+#endif
+            templayer = templayer->nextLayer;
+        }
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+        numLayers = layerIndex;
+#endif
+    }
+
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    for(i=0; i<numLayers && i<SMARTMATRIX_PROFILING_MAX_LAYERS; i++)
+        smProfileCounterAdd(&layerProfiles[i].fillRefreshRow, layerTicks[i]);
+#endif
+}
+
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+// a callback can't be interrupted, but one that takes longer than its budget is removed, so it only delays one row or frame
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::runFrameCallback(void) {
+    smFrameCallback callback = frameCallback;
+    if(!callback)
+        return;
+
+    uint32_t startTime = smProfilingTimestamp();
+    callback();
+    uint32_t ticks = smProfilingTimestamp() - startTime;
+
+    if(ticks > SMARTMATRIX_FRAME_CALLBACK_BUDGET) {
+        frameCallback = NULL;
+        callbackOverrun = true;
+        SM_TRACE(smTraceCallbackOverrun, 0xFF, ticks > 0xFFFF ? 0xFFFF : ticks);
+    }
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    smProfileCounterAdd(&callbackProfile.frameCallback, ticks);
+#endif
 }
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
-INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers48(unsigned char currentRow, unsigned char freeRowBuffer) {
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::runRowCallbacks(uint16_t hardwareY) {
+    uint32_t ticks = 0;
+    uint32_t longestTicks = 0;
+    int longest = -1;
+    bool overrun = false;
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    bool called = false;
+#endif
     int i;
 
-    // static to avoid putting large buffer on the stack
-    static rgb48 tempRow0[PIXELS_PER_LATCH];
-    static rgb48 tempRow1[PIXELS_PER_LATCH];
+    for(i=0; i<SMARTMATRIX_ROW_CALLBACKS; i++) {
+        smRowCallback callback = rowCallbacks[i];
+        if(!callback)
+            continue;
+
+        uint32_t startTime = smProfilingTimestamp();
+        callback(hardwareY);
+        uint32_t callbackTicks = smProfilingTimestamp() - startTime;
+        ticks += callbackTicks;
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+        called = true;
+#endif
 
-    // clear buffer to prevent garbage data showing through transparent layers
-    memset(tempRow0, 0x00, sizeof(tempRow0));
-    memset(tempRow1, 0x00, sizeof(tempRow1));
+        if(callbackTicks > longestTicks) {
+            longestTicks = callbackTicks;
+            longest = i;
+        }
 
-    // get pixel data from layers
-    SM_Layer * templayer = globalinstance->baseLayer;
-    while(templayer) {
-        for(i=0; i<MATRIX_STACK_HEIGHT; i++) {
-            // Z-shape, bottom to top
-            if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // fill data from bottom to top, so bottom panel is the one closest to Teensy
-                templayer->fillRefreshRow(currentRow + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-            // Z-shape, top to bottom
-            } else if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // fill data from top to bottom, so top panel is the one closest to Teensy
-                templayer->fillRefreshRow(currentRow + i*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                templayer->fillRefreshRow(currentRow + matrixRowPairOffset + i*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-            // C-shape, bottom to top
-            } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // alternate direction of filling (or loading) for each matrixwidth
-                // swap row order from top to bottom for each stack (tempRow1 filled with top half of panel, tempRow0 filled with bottom half)
-                if((MATRIX_STACK_HEIGHT-i+1)%2) {
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (i)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + (i)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                } else {
-                    templayer->fillRefreshRow(currentRow + (i)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (i)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                }
-            // C-shape, top to bottom
-            } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && 
-                !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                if((MATRIX_STACK_HEIGHT-i)%2) {
-                    templayer->fillRefreshRow(currentRow + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                } else {
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                }
-            }
+        // the budget is shared by all the row callbacks: once it's used up, drop the callback that took the most of it,
+        // which isn't necessarily the one that went over.  Only one is dropped per row
+        if(!overrun && ticks > SMARTMATRIX_ROW_CALLBACK_BUDGET) {
+            overrun = true;
+            rowCallbacks[longest] = NULL;
+            callbackOverrun = true;
+            SM_TRACE(smTraceCallbackOverrun, longest, longestTicks > 0xFFFF ? 0xFFFF : longestTicks);
         }
-        templayer = templayer->nextLayer;        
     }
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    if(called)
+        smProfileCounterAdd(&callbackProfile.rowCallbacks, ticks);
+#endif
+}
+#endif
 
-    for (i = 0; i < PIXELS_PER_LATCH; i++) {
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers48(unsigned char currentRow, unsigned char freeRowBuffer, rgb48 tempRow0[], rgb48 tempRow1[]) {
+    int i;
+
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    uint32_t packingStartTime = smProfilingTimestamp();
+#endif
+
+    // pixels for all chains, chain n's pixels start at n * PIXELS_PER_LATCH
+    for (i = 0; i < PIXELS_PER_ROW; i++) {
         uint16_t temp0red,temp0green,temp0blue,temp1red,temp1green,temp1blue;
 
-        // for upside down stacks, flip order
-        if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && !((i/matrixWidth)%2)) {
-            int tempPosition = ((i/matrixWidth) * matrixWidth) + matrixWidth - i%matrixWidth - 1;
-            temp0red = tempRow0[tempPosition].red;
-            temp0green = tempRow0[tempPosition].green;
-            temp0blue = tempRow0[tempPosition].blue;
-            temp1red = tempRow1[tempPosition].red;
-            temp1green = tempRow1[tempPosition].green;
-            temp1blue = tempRow1[tempPosition].blue;
-        } else {
-            temp0red = tempRow0[i].red;
-            temp0green = tempRow0[i].green;
-            temp0blue = tempRow0[i].blue;
-            temp1red = tempRow1[i].red;
-            temp1green = tempRow1[i].green;
-            temp1blue = tempRow1[i].blue;
-        }
+        // read pixels in the order they're shifted, see calculatePixelRemap()
+        int tempPosition = PIXEL_REMAP_ENABLED ? pixelRemap[i] : i;
+        temp0red = tempRow0[tempPosition].red;
+        temp0green = tempRow0[tempPosition].green;
+        temp0blue = tempRow0[tempPosition].blue;
+        temp1red = tempRow1[tempPosition].red;
+        temp1green = tempRow1[tempPosition].green;
+        temp1blue = tempRow1[tempPosition].blue;
 
 
 #if 0
@@ -832,12 +1344,8 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
         clkset.p3clk = 1;
 
         // copy words to DMA buffer as a pair, one with clock set low, next with clock set high
-
-        uint32_t * tempptr = (uint32_t*)matrixUpdateData + ((freeRowBuffer*dmaBufferBytesPerRow)/sizeof(uint32_t)) + ((i*dmaBufferBytesPerPixel)/sizeof(uint32_t));
-        *tempptr = o0.word;
-        *(tempptr + latchesPerRow/sizeof(uint32_t)) = o0.word | clkset.word;
-        *(++tempptr) = o1.word;
-        *(tempptr + latchesPerRow/sizeof(uint32_t)) = o1.word | clkset.word;
+        storePixelWord(freeRowBuffer, i, 0, o0.word, clkset.word);
+        storePixelWord(freeRowBuffer, i, 1, o1.word, clkset.word);
 
         //if(latchesPerRow >= 12) {
             union {
@@ -886,8 +1394,7 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
             o2.p3g2 = temp1green   >> (3 + 2 * sizeof(uint32_t));
             o2.p3b2 = temp1blue    >> (3 + 2 * sizeof(uint32_t));
 
-            *(++tempptr) = o2.word;
-            *(tempptr + latchesPerRow/sizeof(uint32_t)) = o2.word | clkset.word;
+            storePixelWord(freeRowBuffer, i, 2, o2.word, clkset.word);
         //}
 
         //if(latchesPerRow == 16) {
@@ -937,8 +1444,7 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
             o3.p3g2 = temp1green   >> (3 + 3 * sizeof(uint32_t));
             o3.p3b2 = temp1blue    >> (3 + 3 * sizeof(uint32_t));
 
-            *(++tempptr) = o3.word;
-            *(tempptr + latchesPerRow/sizeof(uint32_t)) = o3.word | clkset.word;
+            storePixelWord(freeRowBuffer, i, 3, o3.word, clkset.word);
         //}
     }
 
@@ -977,98 +1483,39 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
     o0.p3r2 = (currentRow & 0x08) ? 1 : 0;
     o0.p3g2 = (currentRow & 0x10) ? 1 : 0;
 
-    // set pointer to the byte past the end of the pixel data to shift, and write the currentRow address
-    uint32_t * tempptr2 = (uint32_t*)matrixUpdateData + ((freeRowBuffer*dmaBufferBytesPerRow)/sizeof(uint32_t)) + (((PIXELS_PER_LATCH)*dmaBufferBytesPerPixel)/sizeof(uint32_t));
-    *tempptr2 = o0.word;
-    tempptr2++;
-    *tempptr2 = o0.word;
-    tempptr2++;
-    *tempptr2 = o0.word;
-    tempptr2++;
-    *tempptr2 = o0.word;
-    // stop after 4th word for 48 bit color
+    // write the currentRow address to the bytes past the end of the pixel data to shift
+    storeAddressWords(freeRowBuffer, o0.word);
+#endif
+
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    smProfileCounterAdd(&packingProfile, smProfilingTimestamp() - packingStartTime);
 #endif
 }
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
-INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers36(unsigned char currentRow, unsigned char freeRowBuffer) {
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers36(unsigned char currentRow, unsigned char freeRowBuffer, rgb48 tempRow0[], rgb48 tempRow1[]) {
     int i;
 
-    // static to avoid putting large buffer on the stack
-    static rgb48 tempRow0[PIXELS_PER_LATCH];
-    static rgb48 tempRow1[PIXELS_PER_LATCH];
-
-    // clear buffer to prevent garbage data showing through transparent layers
-    memset(tempRow0, 0x00, sizeof(tempRow0));
-    memset(tempRow1, 0x00, sizeof(tempRow1));
-
-    // get pixel data from layers
-    SM_Layer * templayer = globalinstance->baseLayer;
-    while(templayer) {
-        for(i=0; i<MATRIX_STACK_HEIGHT; i++) {
-            // Z-shape, bottom to top
-            if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // fill data from bottom to top, so bottom panel is the one closest to Teensy
-                templayer->fillRefreshRow(currentRow + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-            // Z-shape, top to bottom
-            } else if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // fill data from top to bottom, so top panel is the one closest to Teensy
-                templayer->fillRefreshRow(currentRow + i*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                templayer->fillRefreshRow(currentRow + matrixRowPairOffset + i*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-            // C-shape, bottom to top
-            } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // alternate direction of filling (or loading) for each matrixwidth
-                // swap row order from top to bottom for each stack (tempRow1 filled with top half of panel, tempRow0 filled with bottom half)
-                if((MATRIX_STACK_HEIGHT-i+1)%2) {
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (i)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + (i)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                } else {
-                    templayer->fillRefreshRow(currentRow + (i)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (i)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                }
-            // C-shape, top to bottom
-            } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && 
-                !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                if((MATRIX_STACK_HEIGHT-i)%2) {
-                    templayer->fillRefreshRow(currentRow + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                } else {
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                }
-            }
-        }
-        templayer = templayer->nextLayer;        
-    }
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    uint32_t packingStartTime = smProfilingTimestamp();
+#endif
 
-    for (i = 0; i < PIXELS_PER_LATCH; i++) {
+    // pixels for all chains, chain n's pixels start at n * PIXELS_PER_LATCH
+    for (i = 0; i < PIXELS_PER_ROW; i++) {
         uint16_t temp0red,temp0green,temp0blue,temp1red,temp1green,temp1blue;
 
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_3, HIGH); // oscilloscope trigger
 #endif
 
-        // for upside down stacks, flip order
-        if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && !((i/matrixWidth)%2)) {
-            int tempPosition = ((i/matrixWidth) * matrixWidth) + matrixWidth - i%matrixWidth - 1;
-            temp0red = tempRow0[tempPosition].red;
-            temp0green = tempRow0[tempPosition].green;
-            temp0blue = tempRow0[tempPosition].blue;
-            temp1red = tempRow1[tempPosition].red;
-            temp1green = tempRow1[tempPosition].green;
-            temp1blue = tempRow1[tempPosition].blue;
-        } else {
-            temp0red = tempRow0[i].red;
-            temp0green = tempRow0[i].green;
-            temp0blue = tempRow0[i].blue;
-            temp1red = tempRow1[i].red;
-            temp1green = tempRow1[i].green;
-            temp1blue = tempRow1[i].blue;
-        }
+        // read pixels in the order they're shifted, see calculatePixelRemap()
+        int tempPosition = PIXEL_REMAP_ENABLED ? pixelRemap[i] : i;
+        temp0red = tempRow0[tempPosition].red;
+        temp0green = tempRow0[tempPosition].green;
+        temp0blue = tempRow0[tempPosition].blue;
+        temp1red = tempRow1[tempPosition].red;
+        temp1green = tempRow1[tempPosition].green;
+        temp1blue = tempRow1[tempPosition].blue;
 
         //if(latchesPerRow == 12) {
             temp0red >>= 4;
@@ -1186,15 +1633,8 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
         clkset.p3clk = 1;
 
         // copy words to DMA buffer as a pair, one with clock set low, next with clock set high
-
-        uint32_t * tempptr = (uint32_t*)matrixUpdateData + ((freeRowBuffer*dmaBufferBytesPerRow)/sizeof(uint32_t)) + ((i*dmaBufferBytesPerPixel)/sizeof(uint32_t));
-        *tempptr = o0.word;
-
-        *(tempptr + latchesPerRow/sizeof(uint32_t)) = o0.word | clkset.word;
-
-        *(++tempptr) = o1.word;
-
-        *(tempptr + latchesPerRow/sizeof(uint32_t)) = o1.word | clkset.word;
+        storePixelWord(freeRowBuffer, i, 0, o0.word, clkset.word);
+        storePixelWord(freeRowBuffer, i, 1, o1.word, clkset.word);
  
         //if(latchesPerRow >= 12) {
             union {
@@ -1243,9 +1683,7 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
             o2.p3g2 = temp1green   >> (3 + 2 * sizeof(uint32_t));
             o2.p3b2 = temp1blue    >> (3 + 2 * sizeof(uint32_t));
 
-            *(++tempptr) = o2.word;
-            
-            *(tempptr + latchesPerRow/sizeof(uint32_t)) = o2.word | clkset.word;
+            storePixelWord(freeRowBuffer, i, 2, o2.word, clkset.word);
         //}
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_3, LOW); // oscilloscope trigger
@@ -1299,8 +1737,7 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
             o3.p3g2 = temp1green   >> (3 + 3 * sizeof(uint32_t));
             o3.p3b2 = temp1blue    >> (3 + 3 * sizeof(uint32_t));
 
-            *(++tempptr) = o3.word;
-            *(tempptr + latchesPerRow/sizeof(uint32_t)) = o3.word | clkset.word;
+            storePixelWord(freeRowBuffer, i, 3, o3.word, clkset.word);
         }
 #endif
     }
@@ -1340,92 +1777,35 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
     o0.p3r2 = (currentRow & 0x08) ? 1 : 0;
     o0.p3g2 = (currentRow & 0x10) ? 1 : 0;
 
-    // set pointer to the byte past the end of the pixel data to shift, and write the currentRow address
-    uint32_t * tempptr2 = (uint32_t*)matrixUpdateData + ((freeRowBuffer*dmaBufferBytesPerRow)/sizeof(uint32_t)) + (((PIXELS_PER_LATCH)*dmaBufferBytesPerPixel)/sizeof(uint32_t));
-    *tempptr2 = o0.word;
-    tempptr2++;
-    *tempptr2 = o0.word;
-    tempptr2++;
-    *tempptr2 = o0.word;
-    // stop after 3rd word for 36 bit color
+    // write the currentRow address to the bytes past the end of the pixel data to shift
+    storeAddressWords(freeRowBuffer, o0.word);
+#endif
+
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    smProfileCounterAdd(&packingProfile, smProfilingTimestamp() - packingStartTime);
 #endif
 }
 
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
-INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers24(unsigned char currentRow, unsigned char freeRowBuffer) {
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers24(unsigned char currentRow, unsigned char freeRowBuffer, rgb24 tempRow0[], rgb24 tempRow1[]) {
     int i;
 
-    // static to avoid putting large buffer on the stack
-    static rgb24 tempRow0[PIXELS_PER_LATCH];
-    static rgb24 tempRow1[PIXELS_PER_LATCH];
-
-    // clear buffer to prevent garbage data showing through transparent layers
-    memset(tempRow0, 0x00, sizeof(tempRow0));
-    memset(tempRow1, 0x00, sizeof(tempRow1));
-
-    // get pixel data from layers
-    SM_Layer * templayer = globalinstance->baseLayer;
-    while(templayer) {
-        for(i=0; i<MATRIX_STACK_HEIGHT; i++) {
-            // Z-shape, bottom to top
-            if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // fill data from bottom to top, so bottom panel is the one closest to Teensy
-                templayer->fillRefreshRow(currentRow + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-            // Z-shape, top to bottom
-            } else if(!(optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // fill data from top to bottom, so top panel is the one closest to Teensy
-                templayer->fillRefreshRow(currentRow + i*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                templayer->fillRefreshRow(currentRow + matrixRowPairOffset + i*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-            // C-shape, bottom to top
-            } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) &&
-                (optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                // alternate direction of filling (or loading) for each matrixwidth
-                // swap row order from top to bottom for each stack (tempRow1 filled with top half of panel, tempRow0 filled with bottom half)
-                if((MATRIX_STACK_HEIGHT-i+1)%2) {
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (i)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + (i)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                } else {
-                    templayer->fillRefreshRow(currentRow + (i)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (i)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                }
-            // C-shape, top to bottom
-            } else if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && 
-                !(optionFlags & SMARTMATRIX_OPTIONS_BOTTOM_TO_TOP_STACKING)) {
-                if((MATRIX_STACK_HEIGHT-i)%2) {
-                    templayer->fillRefreshRow(currentRow + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow(currentRow + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                } else {
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + matrixRowPairOffset + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow0[i*matrixWidth]);
-                    templayer->fillRefreshRow((matrixRowsPerFrame-currentRow-1) + (MATRIX_STACK_HEIGHT-i-1)*matrixPanelHeight, &tempRow1[i*matrixWidth]);
-                }
-            }
-        }
-        templayer = templayer->nextLayer;        
-    }
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    uint32_t packingStartTime = smProfilingTimestamp();
+#endif
 
-    for (i = 0; i < PIXELS_PER_LATCH; i++) {
+    // pixels for all chains, chain n's pixels start at n * PIXELS_PER_LATCH
+    for (i = 0; i < PIXELS_PER_ROW; i++) {
         uint8_t temp0red,temp0green,temp0blue,temp1red,temp1green,temp1blue;
 
-        // for upside down stacks, flip order
-        if((optionFlags & SMARTMATRIX_OPTIONS_C_SHAPE_STACKING) && !((i/matrixWidth)%2)) {
-            int tempPosition = ((i/matrixWidth) * matrixWidth) + matrixWidth - i%matrixWidth - 1;
-            temp0red = tempRow0[tempPosition].red;
-            temp0green = tempRow0[tempPosition].green;
-            temp0blue = tempRow0[tempPosition].blue;
-            temp1red = tempRow1[tempPosition].red;
-            temp1green = tempRow1[tempPosition].green;
-            temp1blue = tempRow1[tempPosition].blue;
-        } else {
-            temp0red = tempRow0[i].red;
-            temp0green = tempRow0[i].green;
-            temp0blue = tempRow0[i].blue;
-            temp1red = tempRow1[i].red;
-            temp1green = tempRow1[i].green;
-            temp1blue = tempRow1[i].blue;
-        }
+        // read pixels in the order they're shifted, see calculatePixelRemap()
+        int tempPosition = PIXEL_REMAP_ENABLED ? pixelRemap[i] : i;
+        temp0red = tempRow0[tempPosition].red;
+        temp0green = tempRow0[tempPosition].green;
+        temp0blue = tempRow0[tempPosition].blue;
+        temp1red = tempRow1[tempPosition].red;
+        temp1green = tempRow1[tempPosition].green;
+        temp1blue = tempRow1[tempPosition].blue;
 
         // this technique is from Fadecandy
         union {
@@ -1521,12 +1901,8 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
         clkset.p3clk = 1;
 
         // copy words to DMA buffer as a pair, one with clock set low, next with clock set high
-
-        uint32_t * tempptr = (uint32_t*)matrixUpdateData + ((freeRowBuffer*dmaBufferBytesPerRow)/sizeof(uint32_t)) + ((i*dmaBufferBytesPerPixel)/sizeof(uint32_t));
-        *tempptr = o0.word;
-        *(tempptr + latchesPerRow/sizeof(uint32_t)) = o0.word | clkset.word;
-        *(++tempptr) = o1.word;
-        *(tempptr + latchesPerRow/sizeof(uint32_t)) = o1.word | clkset.word;
+        storePixelWord(freeRowBuffer, i, 0, o0.word, clkset.word);
+        storePixelWord(freeRowBuffer, i, 1, o1.word, clkset.word);
     }
 
 #if (ADDX_UPDATE_BEFORE_LATCH_BYTES > 0)
@@ -1564,12 +1940,12 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
     o0.p3r2 = (currentRow & 0x08) ? 1 : 0;
     o0.p3g2 = (currentRow & 0x10) ? 1 : 0;
 
-    // set pointer to the byte past the end of the pixel data to shift, and write the currentRow address
-    uint32_t * tempptr2 = (uint32_t*)matrixUpdateData + ((freeRowBuffer*dmaBufferBytesPerRow)/sizeof(uint32_t)) + (((PIXELS_PER_LATCH)*dmaBufferBytesPerPixel)/sizeof(uint32_t));
-    *tempptr2 = o0.word;
-    tempptr2++;
-    *tempptr2 = o0.word;
-    // stop after 2nd word for 24 bit color
+    // write the currentRow address to the bytes past the end of the pixel data to shift
+    storeAddressWords(freeRowBuffer, o0.word);
+#endif
+
+#ifdef SMARTMATRIX_PROFILING_ENABLED
+    smProfileCounterAdd(&packingProfile, smProfilingTimestamp() - packingStartTime);
 #endif
 }
 
@@ -1577,7 +1953,7 @@ template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char pan
 INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::loadMatrixBuffers(unsigned char currentRow) {
     int i;
 
-    addresspair rowAddressPair;
+    addresspair rowAddressPair = {0, 0};
 
 #ifndef ADDX_UPDATE_ON_DATA_PINS
     rowAddressPair.bits_to_set = addressLUT[currentRow].bits_to_set;
@@ -1586,6 +1962,15 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
     
     unsigned char freeRowBuffer = cbGetNextWrite(&dmaBuffer);
 
+    // TICKS_PER_ROW is rounded down, add a tick to the row whenever the remainder adds up to a whole tick (Bresenham
+    // style), so every second has exactly TIMER_FREQUENCY ticks and the panel refreshes at exactly refreshRate
+    uint16_t extraTick = 0;
+    rowTicksError += TICKS_PER_ROW_REMAINDER;
+    if(rowTicksError >= ROWS_PER_SECOND) {
+        rowTicksError -= ROWS_PER_SECOND;
+        extraTick = 1;
+    }
+
     for (i = 0; i < latchesPerRow; i++) {
         matrixUpdateBlock* tempptr = (matrixUpdateBlock*)matrixUpdateBlocks + (freeRowBuffer * latchesPerRow) + i;
         // copy bits to set and clear to generate address for current block
@@ -1594,16 +1979,243 @@ INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, opt
 
         tempptr->timerValues.timer_period = timerLUT[i].timer_period;
         tempptr->timerValues.timer_oe = timerLUT[i].timer_oe;
+
+        // the extra tick goes in the first block's padding, with the display off
+        if(!i) {
+            tempptr->timerValues.timer_period += extraTick;
+            tempptr->timerValues.timer_oe += extraTick;
+        }
+    }
+
+#ifdef SMARTMATRIX_PREFETCH_ENABLED
+    // use a row composited ahead of time if there is one
+    if(!cbIsEmpty(&prefetchQueue)) {
+        refreshPixel * prefetchedRow = &prefetchBuffer[cbGetNextRead(&prefetchQueue) * 2 * PIXELS_PER_ROW];
+        packRow(currentRow, freeRowBuffer, prefetchedRow, prefetchedRow + PIXELS_PER_ROW);
+        cbRead(&prefetchQueue);
+        return;
     }
+#endif
+
+    // static to avoid putting large buffer on the stack
+    static refreshPixel tempRow0[PIXELS_PER_ROW];
+    static refreshPixel tempRow1[PIXELS_PER_ROW];
 
+    composeNextRow(tempRow0, tempRow1);
+    packRow(currentRow, freeRowBuffer, tempRow0, tempRow1);
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::packRow(unsigned char currentRow, unsigned char freeRowBuffer, rgb48 tempRow0[], rgb48 tempRow1[]) {
     if(latchesPerRow == 16)
-        loadMatrixBuffers48(currentRow, freeRowBuffer);
+        loadMatrixBuffers48(currentRow, freeRowBuffer, tempRow0, tempRow1);
     else if(latchesPerRow == 12)
-        loadMatrixBuffers36(currentRow, freeRowBuffer);
-    else if(latchesPerRow == 8)
-        loadMatrixBuffers24(currentRow, freeRowBuffer);
+        loadMatrixBuffers36(currentRow, freeRowBuffer, tempRow0, tempRow1);
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+INLINE void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::packRow(unsigned char currentRow, unsigned char freeRowBuffer, rgb24 tempRow0[], rgb24 tempRow1[]) {
+    loadMatrixBuffers24(currentRow, freeRowBuffer, tempRow0, tempRow1);
 }
 
+// composites rows into the prefetch queue until it's full, so the refresh ISR only has to pack them into the DMA buffer
+// call from loop() (or anywhere with time to spare) as often as possible
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::prefetchRows(void) {
+#ifdef SMARTMATRIX_PREFETCH_ENABLED
+    while(true) {
+        // mask the row calculation ISR while compositing, it shares the queue and the layers' refresh state
+        // it's only held off for a single row, the DMA buffer keeps the panel refreshing in the meantime
+        SMDriver::disableRowCalculation();
+
+        if(cbIsFull(&prefetchQueue)) {
+            SMDriver::enableRowCalculation();
+            return;
+        }
+
+        refreshPixel * prefetchedRow = &prefetchBuffer[cbGetNextWrite(&prefetchQueue) * 2 * PIXELS_PER_ROW];
+        composeNextRow(prefetchedRow, prefetchedRow + PIXELS_PER_ROW);
+        cbWrite(&prefetchQueue);
+
+        SMDriver::enableRowCalculation();
+    }
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+uint8_t SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getPrefetchedRows(void) {
+#ifdef SMARTMATRIX_PREFETCH_ENABLED
+    return cbGetCount(&prefetchQueue);
+#else
+    return 0;
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::addRowCallback(smRowCallback callback) {
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+    bool added = false;
+    int i;
+
+    SMDriver::disableRowCalculation();
+    for(i=0; i<SMARTMATRIX_ROW_CALLBACKS; i++) {
+        if(rowCallbacks[i] == callback) {
+            added = true;
+            break;
+        }
+    }
+    for(i=0; i<SMARTMATRIX_ROW_CALLBACKS && !added; i++) {
+        if(!rowCallbacks[i]) {
+            rowCallbacks[i] = callback;
+            added = true;
+        }
+    }
+    SMDriver::enableRowCalculation();
+    return added;
+#else
+    return false;
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::removeRowCallback(smRowCallback callback) {
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+    int i;
+
+    SMDriver::disableRowCalculation();
+    for(i=0; i<SMARTMATRIX_ROW_CALLBACKS; i++) {
+        if(rowCallbacks[i] == callback)
+            rowCallbacks[i] = NULL;
+    }
+    SMDriver::enableRowCalculation();
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::setFrameCallback(smFrameCallback callback) {
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+    frameCallback = callback;
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getCallbackOverrunFlag(void) {
+#ifdef SMARTMATRIX_ROW_CALLBACKS_ENABLED
+    if(callbackOverrun) {
+        callbackOverrun = false;
+        return true;
+    }
+#endif
+    return false;
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::fadeTo(uint8_t brightness, uint16_t frames, smFadeCurve curve) {
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    int i;
+
+    if(!frames) {
+        setBrightness(brightness);
+        return;
+    }
+
+    // the row calculation ISR steps the fade and may recalculate the timer LUT
+    SMDriver::disableRowCalculation();
+
+    // start from what's on the display now, which may be part way through another fade.  dimmingFactor may hold a
+    // setBrightness() that hasn't been applied yet, so it's only used before the timer LUT is first calculated
+    uint16_t startLuminance;
+    if(fadeActive)
+        startLuminance = fadeLuminances[fadeStep];
+    else if(timerLutMsbBlockTicks)
+        startLuminance = timerLutBrightness * 257;
+    else
+        startLuminance = (dimmingMaximum - dimmingFactor) * 257;
+    uint16_t targetLuminance = brightness * 257;
+
+    fadeSteps = (frames < SMARTMATRIX_BRIGHTNESS_FADE_STEPS) ? frames : SMARTMATRIX_BRIGHTNESS_FADE_STEPS;
+    if(curve == smFadeCurvePerceptual) {
+        int32_t startPosition = smLuminanceToPerceptual(startLuminance);
+        int32_t targetPosition = smLuminanceToPerceptual(targetLuminance);
+        for(i=0; i<fadeSteps; i++)
+            fadeLuminances[i] = smPerceptualToLuminance(startPosition + ((targetPosition - startPosition) * i) / fadeSteps);
+    } else {
+        for(i=0; i<fadeSteps; i++)
+            fadeLuminances[i] = startLuminance + (((int32_t)targetLuminance - startLuminance) * i) / fadeSteps;
+    }
+    // both ends are exact, so the last step matches what calculateTimerLut() gives for the new brightness
+    fadeLuminances[0] = startLuminance;
+    fadeLuminances[fadeSteps] = targetLuminance;
+
+    fadeTarget = brightness;
+    fadeFrames = frames;
+    fadeFrame = 0;
+    fadeStep = 0;
+    fadeActive = true;
+    calculateFadeTimerLuts();
+
+    // a setBrightness() that hasn't been applied yet is replaced by the fade
+    brightnessChange = false;
+    for(i=0; i<latchesPerRow; i++)
+        timerLUT[i].timer_oe = fadeOnTimes[0][i];
+
+    SMDriver::enableRowCalculation();
+#else
+    setBrightness(brightness);
+#endif
+}
+
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+bool SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::isFading(void) {
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+    return fadeActive;
+#else
+    return false;
+#endif
+}
+
+#ifdef SMARTMATRIX_BRIGHTNESS_FADE_ENABLED
+// the same on-time as calculateTimerLut(), from light output out of 65535 instead of 255: 65535 is 255 * 257, so
+// brightness * 257 gives exactly the same values
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::calculateFadeTimerLuts(void) {
+    int i, step;
+
+    for(step=0; step<=fadeSteps; step++) {
+        uint32_t dimming = 65535 - fadeLuminances[step];
+
+        for(i=0; i<latchesPerRow; i++) {
+            uint16_t blockTicks = timerLutMsbBlockTicks >> (latchesPerRow - i - 1);
+            // the period is the block's ticks plus the dead time and padding, which are all spent with the display off
+            fadeOnTimes[step][i] = ((blockTicks * dimming) / 65535) + (timerLUT[i].timer_period - blockTicks);
+        }
+    }
+}
+
+// called at the start of each frame while fading: moves to the next step when it's due, only copying timer values
+template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
+void SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::updateFade(void) {
+    int i;
+    uint8_t step;
+
+    fadeFrame++;
+    step = ((uint32_t)fadeFrame * fadeSteps) / fadeFrames;
+
+    if(step != fadeStep) {
+        fadeStep = step;
+        for(i=0; i<latchesPerRow; i++)
+            timerLUT[i].timer_oe = fadeOnTimes[step][i];
+        SM_TRACE(smTraceBrightnessFadeStep, step, fadeLuminances[step]);
+    }
+
+    if(fadeFrame >= fadeFrames) {
+        dimmingFactor = dimmingMaximum - fadeTarget;
+        timerLutBrightness = fadeTarget;
+        fadeActive = false;
+    }
+}
+#endif
+
 // low priority ISR triggered by software interrupt on a DMA channel that doesn't need interrupts otherwise
 template <int refreshDepth, int matrixWidth, int matrixHeight, unsigned char panelType, unsigned char optionFlags>
 void rowCalculationISR(void) {
@@ -1628,38 +2240,30 @@ void rowShiftCompleteISR(void) {
     // done with previous row, mark it as read
     cbRead(&dmaBuffer);
 
+    SM_TRACE(smTraceRowShiftComplete, cbGetCount(&dmaBuffer), 0);
+
     if(cbIsEmpty(&dmaBuffer)) {
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_1, LOW); // oscilloscope trigger
 #endif
-        // point dmaUpdateTimer to repeatedly load from values that set mod to MIN_BLOCK_PERIOD_TICKS and disable OE
-        dmaUpdateTimer.TCD->SADDR = SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::timerPairIdle;
-        // set timer increment to repeat timerPairIdle
-        dmaUpdateTimer.TCD->SLAST = -(TIMER_REGISTERS_TO_UPDATE*sizeof(uint16_t));
-        // disable channel-to-channel linking - don't link dmaClockOutData until buffer is ready
-        dmaUpdateTimer.TCD->CSR &= ~(1 << 5);
+        SMDriver::loadIdleRow(SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::timerPairIdle);
 
         // set flag so other ISR can enable DMA again when data is ready
         SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferUnderrun = true;
 
+        SM_TRACE(smTraceUnderrun, 0, 0);
+
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_1, HIGH); // oscilloscope trigger
 #endif
     } else {
         // get next row to draw to display and update DMA pointers
         int currentRow = cbGetNextRead(&dmaBuffer);
-#ifndef ADDX_UPDATE_ON_DATA_PINS
-        dmaUpdateAddress.TCD->SADDR = &((matrixUpdateBlock*)SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateBlocks + (currentRow * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::latchesPerRow))->addressValues;
-#endif
-        dmaUpdateTimer.TCD->SADDR = &((matrixUpdateBlock*)SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateBlocks + (currentRow * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::latchesPerRow))->timerValues.timer_oe;
-        dmaClockOutData.TCD->SADDR = (uint8_t*)SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::matrixUpdateData + (currentRow * SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::dmaBufferBytesPerRow);
+        SMDriver::loadNextRow(SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getRowBlocks(currentRow), SmartMatrix3<refreshDepth, matrixWidth, matrixHeight, panelType, optionFlags>::getRowData(currentRow));
     }
 
-    // trigger software interrupt (DMA channel interrupt used instead of actual softint)
-    NVIC_SET_PENDING(IRQ_DMA_CH0 + dmaUpdateTimer.channel);
-
-    // clear pending int
-    dmaClockOutData.clearInterrupt();
+    // trigger rowCalculationISR
+    SMDriver::rowShiftCompleteDone();
 
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_1, LOW); // oscilloscope trigger